@@ -1,58 +1,871 @@
-// DependencyGraph.cpp : This file contains the 'main' function. Program execution begins and ends there.
+﻿// DependencyGraph.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
 
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
+#include <queue>
+#include <sstream>
 
 #include "ObjectContext.h"
+#include "EpochObjectContext.h"
 
 #include "FunctionBasedObjectBuilder.h"
-#include "ObjectBuilderProvider.h"
+#include "GraphTopology.h"
+#include "IAsyncObjectBuilder.h"
+#include "IBatchObjectBuilder.h"
+#include "ObjectBuilderRegistry.h"
+#include "ParallelismAnalysis.h"
+#include "StaticObjectBuilder.h"
+#include "TypedObjectContext.h"
+
+#if !defined(_WIN32)
+#include "WorkerProcessPool.h"
+#endif
 
 // Have a choice of which job queue to use
 #include "SingleThreadedJobQueue.h"
 #include "MultithreadedJobQueue.h"
 #include "PriorityBasedMultithreadedJobQueue.h"
+#include "FairShareMultithreadedJobQueue.h"
 
 using namespace std::chrono_literals;
 
 #define ITERATIONCOUNT 20000
 #define THREADCOUNT 16
 
-int main()
-{
-	// Simple example showing how to use the library 
-	//
-	// This uses an arbitrary function to perform the 'build operation'. This is desinged to burn compute cycles so that the parallelism can be seen
-	std::cout << "Building graph" << std::endl;
+static std::vector<int> GetSineSumDependencies(const int& address) {
+	std::vector<int> dependencies;
 
-	auto obp = std::make_shared<dependencygraph::ObjectBuilderProvider<int, double>>();
-	obp->builderProviderFunc = [](const int& address, std::shared_ptr<dependencygraph::IObjectBuilder<int, double>>& pObjectBuilder) -> bool {
+	int dependencyAddress = address / 2;
+	while (dependencyAddress > 0) {
 
-		auto funcBasedObjectBuilder = std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(
-			[](const int& address) {
-				std::vector<int> dependencies;
+		dependencies.push_back(dependencyAddress);
+		dependencyAddress /= 2;
+	}
+	return dependencies;
+}
 
-				int dependencyAddress = address / 2;
-				while (dependencyAddress > 0) {
+// Batch equivalent of the compute burn function used by the function based builders.
+//
+// The loop over the nodes within the batch is the inner loop which allows the compiler to vectorise the calls
+// to sine across the nodes (each node still accumulates its terms in the same order as the scalar version so
+// the results are identical)
+class SineSumBatchObjectBuilder : public dependencygraph::IBatchObjectBuilder<int, double> {
+public:
+	std::vector<int> GetDependencies(const int& address) override {
+		return GetSineSumDependencies(address);
+	}
 
-					dependencies.push_back(dependencyAddress);
-					dependencyAddress /= 2;
-				}
-				return dependencies;
-			},
-			[](const int& address, const std::unordered_map<int, double>& dependencies) {
-				double result = 0;
-				for (int i = 0; i < ITERATIONCOUNT; ++i) {
-					auto radians = (double)(((long long)address) * (long long)i);
-					result += sin(radians);
-				}
+	double BuildObject(const int& address, const std::unordered_map<int, double>& dependencies) override {
+		double result = 0;
+		this->BuildObjects(1, &address, nullptr, nullptr, &result);
+		return result;
+	}
+
+	void BuildObjects(size_t count, const int* addresses, const double* dependencyValues, const size_t* dependencyOffsets, double* results) override {
+		for (size_t j = 0; j < count; ++j)
+			results[j] = 0;
+
+		for (int i = 0; i < ITERATIONCOUNT; ++i) {
+			for (size_t j = 0; j < count; ++j) {
+				auto radians = (double)(((long long)addresses[j]) * (long long)i);
+				results[j] += sin(radians);
+			}
+		}
+	}
+};
+
+#define LARGEVALUESIZE 16384
+#define LARGEVALUECOUNT 16384
+
+typedef std::vector<double> LargeValue;
+typedef std::shared_ptr<const LargeValue> SharedLargeValue;
+
+// Builds a large value from its dependencies by borrowing them through the DependencyValues view, i.e.
+// without them being copied into a map first
+class LargeValueObjectBuilder : public dependencygraph::IObjectBuilder<int, LargeValue> {
+public:
+	std::vector<int> GetDependencies(const int& address) override {
+		return GetSineSumDependencies(address);
+	}
+
+	LargeValue BuildObject(const int& address, const dependencygraph::DependencyValues<int, LargeValue>& dependencies) override {
+		LargeValue result(LARGEVALUESIZE, (double)address);
+		for (size_t i = 0; i < dependencies.size(); ++i)
+			result[0] += dependencies.GetValue(i)[0];
+		return result;
+	}
+};
+
+template <class TValueType>
+static void RunLargeValueBenchmark(const wchar_t* name, std::shared_ptr<dependencygraph::IObjectBuilder<int, TValueType>> objectBuilder) {
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, TValueType, int>>();
+	obp->keyClassFunc = [](const int& address) { return 0; };
+	obp->RegisterBuilder(0, objectBuilder);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	{
+		auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(THREADCOUNT);
+		{
+			dependencygraph::ObjectContext<int, TValueType> objectContext(obp, jobQueue);
+			for (int i = 0; i < LARGEVALUECOUNT; ++i)
+				objectContext.BuildObject(i);
+
+			for (int i = 0; i < LARGEVALUECOUNT; ++i)
+				objectContext.BuildObject(i)->objectBuiltOrFailureWaitHandle.wait();
+		}
+		jobQueue->StopThreads();
+	}
+	auto timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+	std::wcout << name << L": " << (timeTaken.count() / 1000000) << L"ms" << std::endl;
+}
+
+static void RunLargeValueBenchmarks() {
+	std::wcout << std::endl << L"Large values (" << LARGEVALUESIZE << L" doubles per node)" << std::endl;
+
+	// Dependencies copied into a map for every build
+	RunLargeValueBenchmark<LargeValue>(L"Copied dependencies",
+		std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, LargeValue>>(
+			&GetSineSumDependencies,
+			[](const int& address, const std::unordered_map<int, LargeValue>& dependencies) {
+				LargeValue result(LARGEVALUESIZE, (double)address);
+				for (auto& dependency : dependencies)
+					result[0] += dependency.second[0];
 				return result;
-			});
+			}));
 
-		pObjectBuilder = std::dynamic_pointer_cast<dependencygraph::IObjectBuilder<int, double>>(funcBasedObjectBuilder);
+	// Dependencies borrowed from the dependency nodes
+	RunLargeValueBenchmark<LargeValue>(L"Borrowed dependencies", std::make_shared<LargeValueObjectBuilder>());
+
+	// Shared immutable values, the map based interface only copies the handles
+	RunLargeValueBenchmark<SharedLargeValue>(L"Shared immutable values",
+		std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, SharedLargeValue>>(
+			&GetSineSumDependencies,
+			[](const int& address, const std::unordered_map<int, SharedLargeValue>& dependencies) {
+				auto result = std::make_shared<LargeValue>(LARGEVALUESIZE, (double)address);
+				for (auto& dependency : dependencies)
+					(*result)[0] += (*dependency.second)[0];
+				return SharedLargeValue(result);
+			}));
+}
+
+#define OVERHEADNODECOUNT (256 * 1024)
+
+// Near zero cost builder (the sum of two dependencies) for measuring the per-node overhead, i.e. the
+// discovery, scheduling and builder calls rather than the builds themselves. Every variant is called by the
+// object context through IObjectBuilder / IObjectBuilderProvider, so the differences between them are the
+// std::function calls and dependency map copies rather than the virtual calls
+static std::vector<int> GetOverheadDependencies(const int& address) {
+	std::vector<int> dependencies;
+	if (address > 0)
+		dependencies.push_back(address / 2);
+	if (address > 1)
+		dependencies.push_back(address - 1);
+	return dependencies;
+}
+
+class OverheadObjectBuilder : public dependencygraph::IObjectBuilder<int, double> {
+public:
+	std::vector<int> GetDependencies(const int& address) override {
+		return GetOverheadDependencies(address);
+	}
+
+	double BuildObject(const int& address, const dependencygraph::DependencyValues<int, double>& dependencies) override {
+		double result = 1;
+		for (size_t i = 0; i < dependencies.size(); ++i)
+			result += dependencies.GetValue(i) * 0.5;
+		return result;
+	}
+};
+
+class StaticOverheadObjectBuilder : public dependencygraph::StaticObjectBuilder<StaticOverheadObjectBuilder, int, double> {
+public:
+	std::vector<int> DiscoverDependencies(const int& address) {
+		return GetOverheadDependencies(address);
+	}
+
+	double Build(const int& address, const dependencygraph::DependencyValues<int, double>& dependencies) {
+		double result = 1;
+		for (size_t i = 0; i < dependencies.size(); ++i)
+			result += dependencies.GetValue(i) * 0.5;
+		return result;
+	}
+};
+
+template <class TBuilderPolicy = dependencygraph::DynamicObjectBuilderPolicy<int, double>>
+static void RunNodeOverheadBenchmark(const wchar_t* name, std::shared_ptr<typename TBuilderPolicy::Provider> obp) {
+	// The single threaded job queue builds each node inline, so there's no thread hand off in the timings
+	auto jobQueue = std::make_shared<dependencygraph::SingleThreadedJobQueue>();
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	{
+		dependencygraph::ObjectContext<int, double, TBuilderPolicy> objectContext(obp, jobQueue);
+		for (int i = 0; i < OVERHEADNODECOUNT; ++i)
+			objectContext.BuildObject(i)->objectBuiltOrFailureWaitHandle.wait();
+	}
+	auto timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+	std::wcout << name << L": " << (timeTaken.count() / 1000000) << L"ms (" << (timeTaken.count() / OVERHEADNODECOUNT) << L"ns per node)" << std::endl;
+}
+
+static void RunNodeOverheadBenchmarks() {
+	std::wcout << std::endl << L"Per node overhead (" << OVERHEADNODECOUNT << L" near zero cost nodes)" << std::endl;
+
+	auto functionBasedObp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	functionBasedObp->keyClassFunc = [](const int& address) { return 0; };
+	functionBasedObp->RegisterBuilder(0, std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(
+		&GetOverheadDependencies,
+		[](const int& address, const std::unordered_map<int, double>& dependencies) {
+			double result = 1;
+			for (auto& dependency : dependencies)
+				result += dependency.second * 0.5;
+			return result;
+		}));
+	RunNodeOverheadBenchmark(L"Function based builder (std::function, copied dependencies)", functionBasedObp);
+
+	auto virtualObp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	virtualObp->keyClassFunc = [](const int& address) { return 0; };
+	virtualObp->RegisterBuilder(0, std::make_shared<OverheadObjectBuilder>());
+	RunNodeOverheadBenchmark(L"Virtual builder (borrowed dependencies)", virtualObp);
+
+	// The same static builder and provider, called through the interfaces by the default policy and then
+	// directly by the static one
+	auto staticObp = dependencygraph::MakeStaticObjectBuilderProvider<int, double>(std::make_shared<StaticOverheadObjectBuilder>());
+	RunNodeOverheadBenchmark(L"Static builder and provider, dynamic policy (virtual calls, borrowed dependencies)", staticObp);
+	RunNodeOverheadBenchmark<dependencygraph::StaticObjectBuilderPolicy<int, double, StaticOverheadObjectBuilder>>(
+		L"Static builder and provider, static policy (direct calls, borrowed dependencies)", staticObp);
+
+	auto staticFunctionObjectBuilder = dependencygraph::MakeStaticObjectBuilder<int, double>(
+		&GetOverheadDependencies,
+		[](const int& address, const dependencygraph::DependencyValues<int, double>& dependencies) {
+			double result = 1;
+			for (size_t i = 0; i < dependencies.size(); ++i)
+				result += dependencies.GetValue(i) * 0.5;
+			return result;
+		});
+	RunNodeOverheadBenchmark<dependencygraph::StaticObjectBuilderPolicy<int, double, decltype(staticFunctionObjectBuilder)::element_type>>(
+		L"Static function builder and provider, static policy (inlined lambdas, borrowed dependencies)",
+		dependencygraph::MakeStaticObjectBuilderProvider<int, double>(staticFunctionObjectBuilder));
+}
+
+#define REUSERUNCOUNT 5
+
+// Builds the same graph several times, either with a new object context per run or by resetting one object
+// context between runs, the timings include the teardown of the contexts
+static void RunContextReuseBenchmarks() {
+	std::wcout << std::endl << L"Object context reuse (" << REUSERUNCOUNT << L" runs of " << OVERHEADNODECOUNT << L" near zero cost nodes)" << std::endl;
+
+	auto obp = dependencygraph::MakeStaticObjectBuilderProvider<int, double>(std::make_shared<StaticOverheadObjectBuilder>());
+	auto jobQueue = std::make_shared<dependencygraph::SingleThreadedJobQueue>();
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < REUSERUNCOUNT; ++run) {
+		dependencygraph::ObjectContext<int, double> objectContext(obp, jobQueue);
+		for (int i = 0; i < OVERHEADNODECOUNT; ++i)
+			objectContext.BuildObject(i)->objectBuiltOrFailureWaitHandle.wait();
+	}
+	auto timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+	std::wcout << L"New object context per run: " << (timeTaken.count() / 1000000) << L"ms" << std::endl;
+
+	startTime = std::chrono::high_resolution_clock::now();
+	{
+		dependencygraph::ObjectContext<int, double> objectContext(obp, jobQueue);
+		for (int run = 0; run < REUSERUNCOUNT; ++run) {
+			if (run > 0)
+				objectContext.Reset();
+
+			for (int i = 0; i < OVERHEADNODECOUNT; ++i)
+				objectContext.BuildObject(i)->objectBuiltOrFailureWaitHandle.wait();
+		}
+	}
+	timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+	std::wcout << L"Reset object context: " << (timeTaken.count() / 1000000) << L"ms" << std::endl;
+}
+
+#define EPOCHCHAINLENGTH 200
+
+static std::atomic<int> epochBuildCount(0);
+
+// The root depends on A and the input Y, A depends on a long chain of nodes (ending at the input X1) and the
+// input X2. Inputs have negative addresses: Y = -1, X1 = -2 and X2 = -3
+static std::vector<int> GetEpochDependencies(const int& address) {
+	if (address == 0)
+		return std::vector<int>{ 1, -1 };
+	if (address == 1)
+		return std::vector<int>{ 2, -3 };
+	if (address < EPOCHCHAINLENGTH + 1)
+		return std::vector<int>{ address + 1 };
+	return std::vector<int>{ -2 };
+}
+
+static double BuildEpochObject(const int& address, const std::unordered_map<int, double>& dependencies) {
+	++epochBuildCount;
+
+	double result = 1;
+	for (auto& dependency : dependencies)
+		result += dependency.second;
+	return result;
+}
+
+// Updates a different input in each of three epochs and counts the nodes rebuilt by each, the chain is only built
+// by the first epoch as neither of the later updates affects it
+static void RunEpochDemo() {
+	std::wcout << std::endl << L"Epoch based evaluation (" << (EPOCHCHAINLENGTH + 2) << L" nodes)" << std::endl;
+
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	obp->keyClassFunc = [](const int& address) { return 0; };
+	obp->RegisterBuilder(0, std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(&GetEpochDependencies, &BuildEpochObject));
+
+	auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(THREADCOUNT);
+	{
+		dependencygraph::EpochObjectContext<int, double> epochObjectContext(obp, jobQueue);
+		epochObjectContext.AddRoot(0);
+		epochObjectContext.SetInput(-1, 1);
+		epochObjectContext.SetInput(-2, 1);
+		epochObjectContext.SetInput(-3, 1);
+
+		for (int epochIdx = 0; epochIdx < 3; ++epochIdx) {
+			if (epochIdx == 1)
+				epochObjectContext.SetInput(-1, 2);
+			else if (epochIdx == 2)
+				epochObjectContext.SetInput(-3, 2);
+
+			epochBuildCount = 0;
+			epochObjectContext.AdvanceEpoch();
+			epochObjectContext.WaitForPendingEpochs();
+
+			auto epoch = epochObjectContext.GetCurrentEpoch();
+			auto pRootValue = epoch->TryGetValue(0);
+			std::wcout << L"Epoch " << epoch->GetEpochNumber() << L": " << epochBuildCount << L" nodes built, root value " << (pRootValue ? *pRootValue : 0) << std::endl;
+		}
+	}
+	jobQueue->StopThreads();
+}
+
+#define TYPEDOPTIONCOUNT 1000
+
+// Node kinds for the typed object context demo, option prices depend on the spot price and volatility of their
+// underlying, each of which has its own key and value type
+struct DemoSpot {
+	using KeyType = std::string;
+	using ValueType = double;
+	using Dependencies = dependencygraph::TypedDependencies<>;
+
+	std::unordered_map<std::string, double> spots;
+
+	static std::tuple<> GetDependencies(const std::string& underlying) {
+		return std::tuple<>();
+	}
+
+	double Build(const std::string& underlying) {
+		return this->spots.at(underlying);
+	}
+};
+
+struct DemoVolatility {
+	using KeyType = std::string;
+	using ValueType = std::vector<double>;
+	using Dependencies = dependencygraph::TypedDependencies<>;
+
+	// A flat term structure, one point per year
+	static std::tuple<> GetDependencies(const std::string& underlying) {
+		return std::tuple<>();
+	}
+
+	static std::vector<double> Build(const std::string& underlying) {
+		return std::vector<double>(5, 0.2);
+	}
+};
+
+struct DemoOptionPrice {
+	using KeyType = int;
+	using ValueType = double;
+	using Dependencies = dependencygraph::TypedDependencies<DemoSpot, DemoVolatility>;
+
+	// Options are keyed on their index, the last option refers to an underlying which has no spot price
+	static std::tuple<std::string, std::string> GetDependencies(const int& option) {
+		auto underlying = option == TYPEDOPTIONCOUNT - 1 ? std::string("Unknown") : std::string(option % 2 == 0 ? "Index" : "Stock");
+		return std::make_tuple(underlying, underlying);
+	}
+
+	static double Build(const int& option, const double& spot, const std::vector<double>& volatilities) {
+		auto strike = 50.0 + option % 100;
+		auto volatility = volatilities[option % volatilities.size()];
+		return std::max(spot - strike, 0.0) + 0.4 * spot * volatility;
+	}
+};
+
+// Prices a book of options through a typed object context, where the builders receive the exact types of their
+// dependencies' values
+static void RunTypedObjectContextDemo() {
+	std::wcout << std::endl << L"Typed object context (" << TYPEDOPTIONCOUNT << L" options)" << std::endl;
+
+	auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(THREADCOUNT);
+	{
+		dependencygraph::TypedObjectContext<DemoSpot, DemoVolatility, DemoOptionPrice> typedObjectContext(jobQueue);
+		typedObjectContext.GetNodeKind<DemoSpot>().spots = { { "Index", 100.0 }, { "Stock", 120.0 } };
+
+		std::vector<std::shared_ptr<dependencygraph::TypedObjectContext<DemoSpot, DemoVolatility, DemoOptionPrice>::Node<DemoOptionPrice>>> optionNodes;
+		for (int i = 0; i < TYPEDOPTIONCOUNT; ++i)
+			optionNodes.push_back(typedObjectContext.BuildObject<DemoOptionPrice>(i));
+
+		double totalValue(0);
+		int failureCount(0);
+		for (auto& optionNode : optionNodes) {
+			optionNode->objectBuiltOrFailureWaitHandle.wait();
+			if (optionNode->getState() == dependencygraph::ObjectBuildingState::ObjectBuilt) {
+				totalValue += optionNode->GetBuiltObject();
+				continue;
+			}
+
+			failureCount++;
+		}
+
+		std::wcout << L"Book value: " << totalValue << L", " << failureCount << L" failed" << std::endl;
+
+		// A failed dependency only fails its dependents, the original exception is kept on the node which threw it
+		auto unknownSpotNode = typedObjectContext.BuildObject<DemoSpot>("Unknown");
+		unknownSpotNode->objectBuiltOrFailureWaitHandle.wait();
+		try {
+			if (unknownSpotNode->exceptionPtr)
+				std::rethrow_exception(unknownSpotNode->exceptionPtr);
+		}
+		catch (const std::out_of_range&) {
+			std::wcout << L"Unknown spot price failed with std::out_of_range" << std::endl;
+		}
+		catch (...) {
+		}
+	}
+	jobQueue->StopThreads();
+}
+
+#define MEMOSCENARIOCOUNT 8
+#define MEMOCURVELENGTH 64
+
+static std::atomic<int> memoBuildCount(0);
+
+// The curve points of a scenario are a chain from the scenario's base point (scenario * 1000), each depending
+// on the previous point's value alone, so that scenarios with the same base point share the same curve
+class CurvePointObjectBuilder : public dependencygraph::IObjectBuilder<int, double> {
+public:
+	std::vector<int> GetDependencies(const int& address) override {
+		return std::vector<int>{ address - 1 };
+	}
+
+	double BuildObject(const int& address, const dependencygraph::DependencyValues<int, double>& dependencies) override {
+		++memoBuildCount;
+
+		auto previousValue = dependencies.GetValue(0);
+		auto result = previousValue + 1;
+		for (int i = 0; i < ITERATIONCOUNT; ++i)
+			result += sin(previousValue * i) / ITERATIONCOUNT;
+		return result;
+	}
+
+	bool IsMemoizable() override {
 		return true;
+	}
+};
+
+// Builds the curves of several scenarios (half of which share a base point) across two object contexts which
+// share a build memo, so that each distinct curve point is only built once
+static void RunBuildMemoDemo() {
+	std::wcout << std::endl << L"Build memo (" << MEMOSCENARIOCOUNT << L" scenarios, " << MEMOCURVELENGTH << L" curve points each)" << std::endl;
+
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	obp->keyClassFunc = [](const int& address) { return address % 1000 == 0 ? 0 : 1; };
+	obp->RegisterBuilder(0, std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(
+		[](const int& address) { return std::vector<int>(); },
+		[](const int& address, const std::unordered_map<int, double>& dependencies) { return 0.25 + (address / 1000) % 2 * 0.5; }));
+	obp->RegisterBuilder(1, std::make_shared<CurvePointObjectBuilder>());
+
+	auto buildMemo = dependencygraph::MakeBuildMemo<int, double>(MEMOSCENARIOCOUNT * MEMOCURVELENGTH);
+	auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(THREADCOUNT);
+	{
+		dependencygraph::ObjectContext<int, double> firstObjectContext(obp, jobQueue);
+		dependencygraph::ObjectContext<int, double> secondObjectContext(obp, jobQueue);
+		firstObjectContext.SetBuildMemo(buildMemo);
+		secondObjectContext.SetBuildMemo(buildMemo);
+
+		std::vector<std::shared_ptr<dependencygraph::ObjectBuilderInfo<int, double>>> curveEnds;
+		for (int scenarioIdx = 0; scenarioIdx < MEMOSCENARIOCOUNT; ++scenarioIdx) {
+			auto& objectContext = scenarioIdx < MEMOSCENARIOCOUNT / 2 ? firstObjectContext : secondObjectContext;
+			curveEnds.push_back(objectContext.BuildObject(scenarioIdx * 1000 + MEMOCURVELENGTH - 1));
+		}
+
+		for (auto& curveEnd : curveEnds)
+			curveEnd->objectBuiltOrFailureWaitHandle.wait();
+
+		std::wcout << memoBuildCount << L" curve points built, " << buildMemo->GetHitCount() << L" memo hits, " << buildMemo->GetWaitCount() << L" waits" << std::endl;
+	}
+	jobQueue->StopThreads();
+}
+
+#define TOPOLOGYNODECOUNT 1000
+
+// Saves the topology of a chain of nodes and restores a second context from it, whose provider overrides the
+// middle of the chain, so that the overridden node is discovered (through the override) rather than restored
+static void RunTopologyDemo() {
+	std::wcout << std::endl << L"Persisted topology (" << TOPOLOGYNODECOUNT << L" nodes)" << std::endl;
+
+	auto chainObjectBuilder = std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(
+		[](const int& address) { return address == 0 ? std::vector<int>() : std::vector<int>{ address - 1 }; },
+		[](const int& address, const std::unordered_map<int, double>& dependencies) {
+			double result = 1;
+			for (auto& dependency : dependencies)
+				result += dependency.second;
+			return result;
+		});
+
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	obp->keyClassFunc = [](const int& address) { return 0; };
+	obp->RegisterBuilder(0, chainObjectBuilder);
+
+	auto overriddenObp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	overriddenObp->keyClassFunc = [](const int& address) { return 0; };
+	overriddenObp->RegisterBuilder(0, chainObjectBuilder);
+	overriddenObp->RegisterOverride(TOPOLOGYNODECOUNT / 2, 0);
+
+	auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(THREADCOUNT);
+	{
+		std::ostringstream stream;
+		{
+			dependencygraph::ObjectContext<int, double> objectContext(obp, jobQueue);
+			objectContext.BuildObject(TOPOLOGYNODECOUNT - 1)->objectBuiltOrFailureWaitHandle.wait();
+			dependencygraph::SaveTopology(objectContext, stream, [](const std::shared_ptr<dependencygraph::IObjectBuilder<int, double>>& objectBuilder) { return std::string("Chain"); });
+		}
+
+		// Held as 64 bit words so that the sections are aligned
+		auto topology = stream.str();
+		std::vector<std::uint64_t> buffer((topology.size() + 7) / 8);
+		std::memcpy(buffer.data(), topology.data(), topology.size());
+
+		dependencygraph::ObjectContext<int, double> objectContext(overriddenObp, jobQueue);
+		auto result = dependencygraph::LoadTopology(
+			objectContext,
+			(const char*)buffer.data(),
+			topology.size(),
+			[&chainObjectBuilder](const std::string& builderId) { return std::dynamic_pointer_cast<dependencygraph::IObjectBuilder<int, double>>(chainObjectBuilder); },
+			dependencygraph::TopologyValidation::builders);
+
+		auto root = objectContext.BuildObject(TOPOLOGYNODECOUNT - 1);
+		root->objectBuiltOrFailureWaitHandle.wait();
+		std::wcout << result.restoredNodeCount << L" nodes restored, " << result.undiscoveredNodeCount << L" left to discover, root value " << root->GetBuiltObject() << std::endl;
+	}
+	jobQueue->StopThreads();
+}
+
+#define FAIRSHAREBATCHNODECOUNT 4096
+#define FAIRSHAREINTERACTIVENODECOUNT 64
+
+static void PrintFairShareStatistics(const std::shared_ptr<dependencygraph::FairShareTenantJobQueue>& tenant) {
+	auto statistics = tenant->GetStatistics();
+	std::wcout << tenant->name.c_str() << L": " << statistics.jobsCompleted << L" jobs, average queue latency "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(statistics.averageQueueLatency).count() << L"us, maximum "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(statistics.maximumQueueLatency).count() << L"us" << std::endl;
+}
+
+// Shares a single thread pool between a large batch graph and a small interactive graph, which is requested
+// once the batch is under way. The interactive tenant's minimum share gives it priority for the next free
+// threads, so its queue latency stays low despite the batch's backlog
+static void RunFairShareDemo(std::shared_ptr<dependencygraph::IObjectBuilderProvider<int, double>> obp) {
+	std::wcout << std::endl << L"Fair share job queue (" << FAIRSHAREBATCHNODECOUNT << L" batch nodes, " << FAIRSHAREINTERACTIVENODECOUNT << L" interactive nodes)" << std::endl;
+
+	dependencygraph::FairShareMultithreadedJobQueue fairShareJobQueue(THREADCOUNT);
+	auto batchTenant = fairShareJobQueue.CreateTenant("Batch");
+	auto interactiveTenant = fairShareJobQueue.CreateTenant("Interactive", 1.0, 0.25);
+
+	{
+		dependencygraph::ObjectContext<int, double> batchObjectContext(obp, batchTenant);
+		dependencygraph::ObjectContext<int, double> interactiveObjectContext(obp, interactiveTenant);
+
+		std::vector<std::shared_ptr<dependencygraph::ObjectBuilderInfo<int, double>>> batchNodes;
+		for (int i = 0; i < FAIRSHAREBATCHNODECOUNT; ++i)
+			batchNodes.push_back(batchObjectContext.BuildObject(i));
+
+		std::this_thread::sleep_for(10ms);
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::vector<std::shared_ptr<dependencygraph::ObjectBuilderInfo<int, double>>> interactiveNodes;
+		for (int i = 0; i < FAIRSHAREINTERACTIVENODECOUNT; ++i)
+			interactiveNodes.push_back(interactiveObjectContext.BuildObject(FAIRSHAREBATCHNODECOUNT + i));
+		for (auto& interactiveNode : interactiveNodes)
+			interactiveNode->objectBuiltOrFailureWaitHandle.wait();
+		auto timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+		std::wcout << L"Interactive graph built in " << (timeTaken.count() / 1000000) << L"ms" << std::endl;
+
+		for (auto& batchNode : batchNodes)
+			batchNode->objectBuiltOrFailureWaitHandle.wait();
+	}
+
+	PrintFairShareStatistics(batchTenant);
+	PrintFairShareStatistics(interactiveTenant);
+	fairShareJobQueue.StopThreads();
+}
+
+#define ASYNCREQUESTCOUNT 256
+#define ASYNCLATENCYMS 10
+
+// Stands in for a remote service, whose requests each take a fixed time to come back. Requests are completed
+// in order by a single service thread, so the job queue's threads are free whilst they're outstanding. The
+// root (address 0) sums the fetched values
+class SimulatedServiceObjectBuilder : public dependencygraph::IAsyncObjectBuilder<int, double> {
+private:
+	struct serviceRequest {
+		std::chrono::steady_clock::time_point dueTime;
+		int address;
+		std::shared_ptr<dependencygraph::IAsyncBuildCompletion<double>> completion;
 	};
 
+	std::mutex _requestsMutex;
+	std::condition_variable _requestsCV;
+	std::queue<serviceRequest> _requests;
+	std::atomic<int> _issuedRequestCount;
+	std::atomic<int> _outstandingRequestCount;
+	bool _stopRequested;
+	std::thread _serviceThread;
+
+	void serveRequests() {
+		std::unique_lock<std::mutex> lock(this->_requestsMutex);
+		while (!this->_stopRequested) {
+			if (this->_requests.empty()) {
+				this->_requestsCV.wait(lock);
+				continue;
+			}
+
+			if (std::chrono::steady_clock::now() < this->_requests.front().dueTime) {
+				this->_requestsCV.wait_until(lock, this->_requests.front().dueTime);
+				continue;
+			}
+
+			auto request = std::move(this->_requests.front());
+			this->_requests.pop();
+			lock.unlock();
+
+			request.completion->SetResult(request.address * 0.5);
+			request.completion = nullptr;
+			this->_outstandingRequestCount--;
+
+			lock.lock();
+		}
+	}
+
+public:
+	SimulatedServiceObjectBuilder() :
+		_issuedRequestCount(0),
+		_outstandingRequestCount(0),
+		_stopRequested(false) {
+		this->_serviceThread = std::thread([this]() { this->serveRequests(); });
+	}
+
+	~SimulatedServiceObjectBuilder() {
+		{
+			std::unique_lock<std::mutex> lock(this->_requestsMutex);
+			this->_stopRequested = true;
+			this->_requestsCV.notify_all();
+		}
+		this->_serviceThread.join();
+	}
+
+	int GetIssuedRequestCount() const {
+		return this->_issuedRequestCount.load();
+	}
+
+	int GetOutstandingRequestCount() const {
+		return this->_outstandingRequestCount.load();
+	}
+
+	std::vector<int> GetDependencies(const int& address) override {
+		std::vector<int> dependencies;
+		if (address == 0) {
+			for (int i = 1; i <= ASYNCREQUESTCOUNT; ++i)
+				dependencies.push_back(i);
+		}
+		return dependencies;
+	}
+
+	void BuildObjectAsync(const int& address, const dependencygraph::DependencyValues<int, double>& dependencies, std::shared_ptr<dependencygraph::IAsyncBuildCompletion<double>> completion) override {
+		if (address == 0) {
+			double result = 0;
+			for (size_t i = 0; i < dependencies.size(); ++i)
+				result += dependencies.GetValue(i);
+			completion->SetResult(std::move(result));
+			return;
+		}
+
+		this->_issuedRequestCount++;
+		this->_outstandingRequestCount++;
+		std::unique_lock<std::mutex> lock(this->_requestsMutex);
+		this->_requests.push(serviceRequest{ std::chrono::steady_clock::now() + std::chrono::milliseconds(ASYNCLATENCYMS), address, completion });
+		this->_requestsCV.notify_all();
+	}
+};
+
+// Fetches a graph's inputs from a (simulated) service, with all of the requests being in flight at once despite
+// the job queue only having a couple of threads. The second context is let go of whilst its requests are still
+// outstanding, whose completions are then ignored
+static void RunAsyncObjectBuilderDemo() {
+	std::wcout << std::endl << L"Asynchronous object builder (" << ASYNCREQUESTCOUNT << L" requests, " << ASYNCLATENCYMS << L"ms latency each)" << std::endl;
+
+	auto objectBuilder = std::make_shared<SimulatedServiceObjectBuilder>();
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	obp->keyClassFunc = [](const int& address) { return 0; };
+	obp->RegisterBuilder(0, objectBuilder);
+
+	auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(2);
+	{
+		dependencygraph::ObjectContext<int, double> objectContext(obp, jobQueue);
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		auto root = objectContext.BuildObject(0);
+		root->objectBuiltOrFailureWaitHandle.wait();
+		auto timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+		std::wcout << L"Root value " << root->GetBuiltObject() << L" built in " << (timeTaken.count() / 1000000) << L"ms on 2 threads ("
+			<< ASYNCREQUESTCOUNT * ASYNCLATENCYMS << L"ms if the requests were made one at a time)" << std::endl;
+	}
+
+	int abandonedRequestCount(0);
+	{
+		dependencygraph::ObjectContext<int, double> objectContext(obp, jobQueue);
+		auto root = objectContext.BuildObject(0);
+
+		// Nodes mustn't be destroyed whilst their jobs are queued, so wait until the requests have all gone out
+		while (objectBuilder->GetIssuedRequestCount() < 2 * ASYNCREQUESTCOUNT)
+			std::this_thread::sleep_for(1ms);
+		abandonedRequestCount = objectBuilder->GetOutstandingRequestCount();
+	}
+
+	while (objectBuilder->GetOutstandingRequestCount() > 0)
+		std::this_thread::sleep_for(1ms);
+	std::wcout << L"Context released with " << abandonedRequestCount << L" requests outstanding, whose completions were ignored" << std::endl;
+
+	jobQueue->StopThreads();
+}
+
+#define ADMISSIONNODECOUNT 16384
+#define ADMISSIONINFLIGHTLIMIT 256
+
+// Requests a large number of independent nodes from a context which only takes on a limited number at a time,
+// first blocking the submitting thread whilst it's at the limit and then queuing the requests instead
+static void RunAdmissionControlDemo() {
+	std::wcout << std::endl << L"Admission control (" << ADMISSIONNODECOUNT << L" nodes, at most " << ADMISSIONINFLIGHTLIMIT << L" in flight)" << std::endl;
+
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	obp->keyClassFunc = [](const int& address) { return 0; };
+	obp->RegisterBuilder(0, std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(
+		[](const int& address) { return std::vector<int>(); },
+		[](const int& address, const std::unordered_map<int, double>& dependencies) {
+			double result = 0;
+			for (int i = 0; i < ITERATIONCOUNT / 20; ++i)
+				result += sin((double)address * i);
+			return result;
+		}));
+
+	auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(THREADCOUNT);
+	for (auto blockSubmission : { true, false }) {
+		dependencygraph::ObjectContext<int, double> objectContext(obp, jobQueue);
+
+		dependencygraph::AdmissionLimits admissionLimits;
+		admissionLimits.maximumInFlightNodes = ADMISSIONINFLIGHTLIMIT;
+		admissionLimits.blockSubmission = blockSubmission;
+		objectContext.SetAdmissionLimits(admissionLimits);
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::vector<std::shared_ptr<dependencygraph::ObjectBuilderInfo<int, double>>> nodes;
+		for (int i = 0; i < ADMISSIONNODECOUNT; ++i)
+			nodes.push_back(objectContext.BuildObject(i));
+		auto submissionTime = std::chrono::high_resolution_clock::now() - startTime;
+
+		int builtCount(0);
+		for (auto& node : nodes) {
+			node->objectBuiltOrFailureWaitHandle.wait();
+			if (node->getState() == dependencygraph::ObjectBuildingState::ObjectBuilt)
+				++builtCount;
+		}
+		auto timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+
+		std::wcout << (blockSubmission ? L"Blocking submission: " : L"Queued submission: ") << builtCount << L" nodes built in " << (timeTaken.count() / 1000000)
+			<< L"ms, requests made in " << (submissionTime.count() / 1000000) << L"ms, peak in flight " << objectContext.GetAdmissionController().GetPeakInFlightNodeCount() << std::endl;
+	}
+	jobQueue->StopThreads();
+}
+
+#if !defined(_WIN32)
+#define WORKERPROCESSCOUNT 2
+#define WORKERPROCESSNODECOUNT 256
+
+static pid_t workerProcessParentPid;
+
+// Chains of 8 nodes, so that dependency values are passed to the workers as well as keys
+static std::vector<int> GetWorkerProcessDependencies(const int& address) {
+	if (address % 8 == 0)
+		return std::vector<int>();
+
+	return std::vector<int>{ address - 1 };
+}
+
+static double SineSum(int address) {
+	double result = 0;
+	for (int i = 0; i < ITERATIONCOUNT; ++i) {
+		auto radians = (double)(((long long)address) * (long long)i);
+		result += sin(radians);
+	}
+	return result;
+}
+
+static double BuildWorkerProcessObject(const int& address, const std::unordered_map<int, double>& dependencies) {
+	if (getpid() == workerProcessParentPid)
+		throw std::runtime_error("Expected to be built in a worker process");
+
+	auto result = SineSum(address);
+	for (auto& dependency : dependencies)
+		result += dependency.second;
+	return result;
+}
+
+// Builds a graph in forked worker processes and checks the results against building it in process. The workers
+// are forked before any of the demo's threads have been started, as forking a multi-threaded process is unsafe
+static void RunWorkerProcessDemo() {
+	std::wcout << L"Worker processes (" << WORKERPROCESSCOUNT << L" workers, " << WORKERPROCESSNODECOUNT << L" nodes)" << std::endl;
+	workerProcessParentPid = getpid();
+
+	auto workerProcessPool = std::make_shared<dependencygraph::WorkerProcessPool<int, double>>(dependencygraph::WorkerProcessSerialization<int, double>::TriviallyCopyable());
+	auto builderId = workerProcessPool->RegisterBuilder(std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(&GetWorkerProcessDependencies, &BuildWorkerProcessObject));
+	workerProcessPool->Start(WORKERPROCESSCOUNT);
+
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	obp->keyClassFunc = [](const int& address) { return 0; };
+	obp->RegisterBuilder(0, std::make_shared<dependencygraph::WorkerProcessObjectBuilder<int, double>>(workerProcessPool, builderId));
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	int matchedCount(0);
+	{
+		auto jobQueue = std::make_shared<dependencygraph::MultithreadedJobQueue>(WORKERPROCESSCOUNT);
+		dependencygraph::ObjectContext<int, double> objectContext(obp, jobQueue);
+
+		std::vector<std::shared_ptr<dependencygraph::ObjectBuilderInfo<int, double>>> nodes;
+		for (int i = 0; i < WORKERPROCESSNODECOUNT; ++i)
+			nodes.push_back(objectContext.BuildObject(i));
+
+		double expected(0);
+		for (int i = 0; i < WORKERPROCESSNODECOUNT; ++i) {
+			nodes[i]->objectBuiltOrFailureWaitHandle.wait();
+			expected = (i % 8 == 0 ? 0 : expected) + SineSum(i);
+			if (nodes[i]->getState() == dependencygraph::ObjectBuildingState::ObjectBuilt && nodes[i]->GetBuiltObject() == expected)
+				++matchedCount;
+		}
+
+		jobQueue->StopThreads();
+	}
+	auto timeTaken = std::chrono::high_resolution_clock::now() - startTime;
+
+	workerProcessPool->Stop();
+	std::wcout << L"Built in worker processes: " << matchedCount << L" of " << WORKERPROCESSNODECOUNT << L" matched; " << (timeTaken.count() / 1000000) << L"ms" << std::endl << std::endl;
+}
+#endif
+
+static void RunBenchmark(const wchar_t* name, std::shared_ptr<dependencygraph::IObjectBuilderProvider<int, double>> obp) {
+	std::wcout << std::endl << name << std::endl;
+
 	{
 		auto totalStartTime = std::chrono::high_resolution_clock::now();
 
@@ -105,6 +918,7 @@ int main()
 				switch (pOBI->getState()) {
 				case dependencygraph::ObjectBuildingState::ObjectBuilt:
 				case dependencygraph::ObjectBuildingState::Failure:
+				case dependencygraph::ObjectBuildingState::Cancelled:
 					++handledCount;
 					break;
 
@@ -129,9 +943,77 @@ int main()
 		auto totalTimeTaken = totalEnd - totalStartTime;
 		std::wcout << L"Waiting time: " << (waitingTime.count() / 1000000) << L"ms" << std::endl;
 		std::wcout << L"Total time taken: " << (totalTimeTaken.count() / 1000000) << L"ms" << std::endl;
+
+		// What the shape of the graph allows for, given the measured build times, vs. what was achieved
+		auto analysis = dependencygraph::AnalyseParallelism(objectContext);
+		std::wcout << L"Work: " << (analysis.work.count() / 1000000) << L"ms; span (critical path of " << analysis.criticalPath.size() << L" nodes): " << (analysis.span.count() / 1000000) << L"ms; levels: " << analysis.widthPerLevel.size() << std::endl;
+		std::wcout << L"Ideal speedup (" << THREADCOUNT << L" threads): " << analysis.GetIdealSpeedup(THREADCOUNT) << L"; measured speedup: " << analysis.GetMeasuredSpeedup() << std::endl;
 	}
 
 	std::wcout << L"Object Context gone" << std::endl;
+}
+
+int main()
+{
+#if !defined(_WIN32)
+	RunWorkerProcessDemo();
+#endif
+
+	// Simple example showing how to use the library 
+	//
+	// This uses an arbitrary function to perform the 'build operation'. This is desinged to burn compute cycles so that the parallelism can be seen
+	std::cout << "Building graph" << std::endl;
+
+	// Every address within the demo graph is built in the same way, so there's only a single key class and
+	// hence a single (shared) object builder
+	auto obp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	obp->keyClassFunc = [](const int& address) { return 0; };
+	obp->builderFactoryFunc = [](const int& keyClass, std::shared_ptr<dependencygraph::IObjectBuilder<int, double>>& pObjectBuilder) -> bool {
+
+		auto funcBasedObjectBuilder = std::make_shared<dependencygraph::FunctionBasedObjectBuilder<int, double>>(
+			&GetSineSumDependencies,
+			[](const int& address, const std::unordered_map<int, double>& dependencies) {
+				double result = 0;
+				for (int i = 0; i < ITERATIONCOUNT; ++i) {
+					auto radians = (double)(((long long)address) * (long long)i);
+					result += sin(radians);
+				}
+				return result;
+			});
+
+		pObjectBuilder = std::dynamic_pointer_cast<dependencygraph::IObjectBuilder<int, double>>(funcBasedObjectBuilder);
+		return true;
+	};
+
+	RunBenchmark(L"Function based object builders", obp);
+
+	// The same graph, but with a single shared batch object builder so that ready nodes can be built
+	// together, allowing the compute burn to be vectorised across nodes
+	auto batchObp = std::make_shared<dependencygraph::ObjectBuilderRegistry<int, double, int>>();
+	batchObp->keyClassFunc = [](const int& address) { return 0; };
+	batchObp->RegisterBuilder(0, std::make_shared<SineSumBatchObjectBuilder>());
+
+	RunBenchmark(L"Batch object builder", batchObp);
+
+	RunLargeValueBenchmarks();
+
+	RunNodeOverheadBenchmarks();
+
+	RunContextReuseBenchmarks();
+
+	RunEpochDemo();
+
+	RunFairShareDemo(obp);
+
+	RunTypedObjectContextDemo();
+
+	RunBuildMemoDemo();
+
+	RunTopologyDemo();
+
+	RunAsyncObjectBuilderDemo();
+
+	RunAdmissionControlDemo();
 
 	if (false)
 	{
@@ -156,4 +1038,5 @@ int main()
 	}
 
 	obp = nullptr;
+	batchObp = nullptr;
 }
\ No newline at end of file
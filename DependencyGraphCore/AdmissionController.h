@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "IDependencyGraphJobQueue.h"
+
+namespace dependencygraph {
+
+	// Limits on the amount of outstanding work which an object context will take on, zero being unlimited
+	struct AdmissionLimits {
+	public:
+		// The number of nodes which have been requested but which haven't completed yet
+		long long maximumInFlightNodes;
+
+		// The number of jobs waiting in the job queue (see IDependencyGraphJobQueue::GetQueuedJobCount)
+		long long maximumQueuedJobs;
+
+		// Whether requests over the limits block the submitting thread until there's capacity, otherwise
+		// the node is returned straight away and the request is queued until it can be admitted. Requests
+		// made from job queue threads, or from the call backs of a node (e.g. an asynchronous build's
+		// completion or a coroutine resumed inline), are always queued rather than blocked, as those threads
+		// may be the ones which would free up the capacity
+		bool blockSubmission;
+
+		AdmissionLimits() :
+			maximumInFlightNodes(0),
+			maximumQueuedJobs(0),
+			blockSubmission(true) {
+		}
+	};
+
+	// Admission control for requests made to an object context, so that a very large number of requests
+	// is taken on as a moving frontier rather than discovering and scheduling everything up front.
+	//
+	// Only requests made by the caller are held back, the dependencies of an admitted request are always
+	// requested straight away (as holding them back could deadlock), so the limits are soft, i.e. the
+	// in-flight count can exceed the limit by the size of the graphs being admitted.
+	//
+	// Queued requests are re-checked as the owner's nodes complete. When none of them are in flight, the
+	// capacity can only be freed up by the job queue draining (e.g. of other contexts' jobs), so a re-check job
+	// is registered with the queue instead, which runs once the jobs ahead of it have been taken.
+	class AdmissionController {
+	private:
+		// Shared with any scheduled re-check job, which may still be queued when the controller is destroyed
+		struct recheckState {
+			std::recursive_mutex mutex;
+			AdmissionController* controller;
+		};
+
+		std::mutex _mutex;
+		std::condition_variable _capacityCV;
+
+		AdmissionLimits _limits;
+		std::atomic<long long> _inFlightNodes;
+		std::atomic<long long> _peakInFlightNodes;
+
+		// Requests which are waiting for capacity, either blocked submitters or queued requests
+		std::atomic<int> _waitingCount;
+		std::deque<std::function<void()>> _pendingRequests;
+		std::atomic<bool> _admittingPendingRequests;
+
+		std::shared_ptr<recheckState> _recheckState;
+		std::atomic<bool> _recheckScheduled;
+
+		bool hasCapacity(IDependencyGraphJobQueue* jobQueue) const;
+		void admitPendingRequests(IDependencyGraphJobQueue* jobQueue);
+		void scheduleRecheck(IDependencyGraphJobQueue* jobQueue);
+
+	public:
+		AdmissionController() :
+			_inFlightNodes(0),
+			_peakInFlightNodes(0),
+			_waitingCount(0),
+			_admittingPendingRequests(false),
+			_recheckState(std::make_shared<recheckState>()),
+			_recheckScheduled(false) {
+			this->_recheckState->controller = this;
+		}
+
+		~AdmissionController() {
+			this->StopRechecks();
+		}
+
+		// Should be set before any objects are requested
+		void SetLimits(const AdmissionLimits& limits) {
+			this->_limits = limits;
+		}
+
+		const AdmissionLimits& GetLimits() const {
+			return this->_limits;
+		}
+
+		bool IsEnabled() const {
+			return this->_limits.maximumInFlightNodes > 0 || this->_limits.maximumQueuedJobs > 0;
+		}
+
+		long long GetInFlightNodeCount() const {
+			return this->_inFlightNodes.load();
+		}
+
+		long long GetPeakInFlightNodeCount() const {
+			return this->_peakInFlightNodes.load();
+		}
+
+		bool HasPendingRequests() {
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			return !this->_pendingRequests.empty();
+		}
+
+		// Blocks the calling thread until the request can be admitted
+		void WaitForCapacity(IDependencyGraphJobQueue* jobQueue);
+
+		// Returns true if the request can be admitted straight away, otherwise the admission function is
+		// queued and will be called (on whichever thread frees up the capacity) once it can be. Admission
+		// functions are expected to handle their own failures, e.g. by failing the node
+		bool TryAdmitOrQueue(IDependencyGraphJobQueue* jobQueue, std::function<void()>&& admitFunc);
+
+		// Stops any re-check job which is still queued from admitting requests, this should be called before
+		// anything which the admission functions refer to is destroyed. Waits for a re-check which is running
+		void StopRechecks() {
+			std::unique_lock<std::recursive_mutex> lock(this->_recheckState->mutex);
+			this->_recheckState->controller = nullptr;
+		}
+
+		void NodeStarted();
+		void NodeCompleted(IDependencyGraphJobQueue* jobQueue);
+	};
+
+	inline bool AdmissionController::hasCapacity(IDependencyGraphJobQueue* jobQueue) const {
+		if (this->_limits.maximumInFlightNodes > 0 && this->_inFlightNodes.load() >= this->_limits.maximumInFlightNodes)
+			return false;
+
+		if (this->_limits.maximumQueuedJobs > 0 && jobQueue && (long long)jobQueue->GetQueuedJobCount() >= this->_limits.maximumQueuedJobs)
+			return false;
+
+		return true;
+	}
+
+	inline void AdmissionController::WaitForCapacity(IDependencyGraphJobQueue* jobQueue) {
+		if (this->hasCapacity(jobQueue) && this->_waitingCount.load() == 0)
+			return;
+
+		this->_waitingCount.fetch_add(1);
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+
+			// Nodes completing and the queued requests being admitted are signalled, whereas jobs leaving the
+			// queue aren't, so the queued job limit is re-checked periodically, backing off whilst it's reached
+			auto recheckInterval = std::chrono::microseconds(100);
+			while (!this->_pendingRequests.empty() || !this->hasCapacity(jobQueue)) {
+				if (this->_limits.maximumQueuedJobs > 0 && jobQueue && (long long)jobQueue->GetQueuedJobCount() >= this->_limits.maximumQueuedJobs) {
+					this->_capacityCV.wait_for(lock, recheckInterval);
+					recheckInterval = std::min(recheckInterval * 2, std::chrono::microseconds(10000));
+				}
+				else {
+					this->_capacityCV.wait(lock);
+				}
+			}
+		}
+		this->_waitingCount.fetch_sub(1);
+	}
+
+	inline bool AdmissionController::TryAdmitOrQueue(IDependencyGraphJobQueue* jobQueue, std::function<void()>&& admitFunc) {
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			if (this->_pendingRequests.empty() && this->hasCapacity(jobQueue))
+				return true;
+
+			this->_pendingRequests.push_back(std::move(admitFunc));
+			this->_waitingCount.fetch_add(1);
+		}
+
+		// Capacity may have been freed up in the meantime, this also schedules a re-check if nothing else will
+		this->admitPendingRequests(jobQueue);
+		return false;
+	}
+
+	inline void AdmissionController::NodeStarted() {
+		auto inFlightNodes = this->_inFlightNodes.fetch_add(1) + 1;
+		auto peakInFlightNodes = this->_peakInFlightNodes.load();
+		while (inFlightNodes > peakInFlightNodes && !this->_peakInFlightNodes.compare_exchange_weak(peakInFlightNodes, inFlightNodes)) {
+		}
+	}
+
+	inline void AdmissionController::NodeCompleted(IDependencyGraphJobQueue* jobQueue) {
+		this->_inFlightNodes.fetch_sub(1);
+		if (this->_waitingCount.load() == 0)
+			return;
+
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			this->_capacityCV.notify_all();
+		}
+
+		this->admitPendingRequests(jobQueue);
+	}
+
+	// Admits queued requests for as long as there's capacity. Only one thread does this at a time, so that
+	// a request which completes straight away (e.g. on a single threaded job queue) doesn't recurse
+	inline void AdmissionController::admitPendingRequests(IDependencyGraphJobQueue* jobQueue) {
+		while (!this->_admittingPendingRequests.exchange(true)) {
+			while (true) {
+				std::function<void()> admitFunc;
+				{
+					std::unique_lock<std::mutex> lock(this->_mutex);
+					if (this->_pendingRequests.empty() || !this->hasCapacity(jobQueue))
+						break;
+
+					admitFunc = std::move(this->_pendingRequests.front());
+					this->_pendingRequests.pop_front();
+					this->_waitingCount.fetch_sub(1);
+					if (this->_pendingRequests.empty())
+						this->_capacityCV.notify_all();
+				}
+
+				// Admission functions handle their own failures, this only stops an escaping exception from
+				// leaving the flag set and so stalling the remaining requests
+				try {
+					admitFunc();
+				}
+				catch (...) {
+
+				}
+			}
+
+			this->_admittingPendingRequests.store(false);
+
+			// Capacity may have been freed up after we last checked, but whilst we still held the flag
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			if (this->_pendingRequests.empty() || !this->hasCapacity(jobQueue))
+				break;
+		}
+
+		this->scheduleRecheck(jobQueue);
+	}
+
+	// Registers a job to re-check the queued requests if none of the owner's nodes are in flight, as nothing else
+	// would then check them again. At most one re-check job is queued at a time
+	inline void AdmissionController::scheduleRecheck(IDependencyGraphJobQueue* jobQueue) {
+		if (!jobQueue || this->_inFlightNodes.load() > 0 || this->_recheckScheduled.load())
+			return;
+
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			if (this->_pendingRequests.empty())
+				return;
+		}
+
+		if (this->_recheckScheduled.exchange(true))
+			return;
+
+		auto recheckState = this->_recheckState;
+		jobQueue->RegisterJob(DependencyGraphJob(DependencyGraphJobStyle::other, [recheckState, jobQueue]() {
+			std::unique_lock<std::recursive_mutex> lock(recheckState->mutex);
+			auto controller = recheckState->controller;
+			if (!controller)
+				return;
+
+			controller->_recheckScheduled.store(false);
+			controller->admitPendingRequests(jobQueue);
+			}));
+	}
+}
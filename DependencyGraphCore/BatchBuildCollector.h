@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "IBatchObjectBuilder.h"
+#include "IDependencyGraphJobQueue.h"
+#include "ObjectBuilderInfo.h"
+
+namespace dependencygraph {
+
+	// Collects together nodes which are ready to be built and which share a batch object builder so that
+	// they can be built with a single call.
+	//
+	// Rather than registering one job per node, a single job is registered per builder whenever the first
+	// node arrives. By the time that the job runs, further nodes may have become ready and these will be
+	// built in the same batch. Where there are more pending nodes than the builder's maximum batch size, a
+	// further job is registered so that the remaining nodes can be built in parallel.
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	class BatchBuildCollector {
+	private:
+		struct PendingBatch {
+			std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> nodes;
+			bool jobRegistered;
+
+			PendingBatch() : jobRegistered(false) { }
+		};
+
+		std::mutex _pendingAccessMutex;
+		std::unordered_map<IBatchObjectBuilder<TKeyType, TValueType>*, PendingBatch> _pending;
+
+		void buildPending(IBatchObjectBuilder<TKeyType, TValueType>* batchObjectBuilder, std::shared_ptr<IDependencyGraphJobQueue> jobQueue);
+
+	public:
+		void RegisterReadyObject(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi,
+			IBatchObjectBuilder<TKeyType, TValueType>* batchObjectBuilder,
+			std::shared_ptr<IDependencyGraphJobQueue>& jobQueue);
+	};
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void BatchBuildCollector<TKeyType, TValueType, TBuilderPolicy>::RegisterReadyObject(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi,
+		IBatchObjectBuilder<TKeyType, TValueType>* batchObjectBuilder,
+		std::shared_ptr<IDependencyGraphJobQueue>& jobQueue) {
+		{
+			std::unique_lock<std::mutex> lock(this->_pendingAccessMutex);
+			auto& pendingBatch = this->_pending[batchObjectBuilder];
+			pendingBatch.nodes.push_back(obi);
+			if (pendingBatch.jobRegistered)
+				return;
+
+			pendingBatch.jobRegistered = true;
+		}
+
+		DependencyGraphJob job(DependencyGraphJobStyle::objectBuilding, std::bind(&BatchBuildCollector<TKeyType, TValueType, TBuilderPolicy>::buildPending, this, batchObjectBuilder, jobQueue));
+		jobQueue->RegisterJob(std::move(job));
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void BatchBuildCollector<TKeyType, TValueType, TBuilderPolicy>::buildPending(IBatchObjectBuilder<TKeyType, TValueType>* batchObjectBuilder, std::shared_ptr<IDependencyGraphJobQueue> jobQueue) {
+		std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> batch;
+		bool moreToBuild(false);
+		{
+			auto maxBatchSize = batchObjectBuilder->GetMaxBatchSize();
+			if (maxBatchSize == 0)
+				maxBatchSize = 1;
+
+			std::unique_lock<std::mutex> lock(this->_pendingAccessMutex);
+			auto& pendingBatch = this->_pending[batchObjectBuilder];
+			if (pendingBatch.nodes.size() <= maxBatchSize) {
+				batch.swap(pendingBatch.nodes);
+				pendingBatch.jobRegistered = false;
+			}
+			else {
+				// Leave the job flagged as registered as we're about to register another one to handle the rest
+				auto splitPoint = pendingBatch.nodes.end() - maxBatchSize;
+				batch.assign(splitPoint, pendingBatch.nodes.end());
+				pendingBatch.nodes.erase(splitPoint, pendingBatch.nodes.end());
+				moreToBuild = true;
+			}
+		}
+
+		if (moreToBuild) {
+			DependencyGraphJob job(DependencyGraphJobStyle::objectBuilding, std::bind(&BatchBuildCollector<TKeyType, TValueType, TBuilderPolicy>::buildPending, this, batchObjectBuilder, jobQueue));
+			jobQueue->RegisterJob(std::move(job));
+		}
+
+		ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::BuildObjects(batch, batchObjectBuilder);
+	}
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace dependencygraph {
+
+	// Running estimate of how long a single object builder takes to build one object
+	class BuilderBuildCost {
+	private:
+		std::atomic<long long> _sampleCount;
+		std::atomic<long long> _averageBuildTimeNs;
+
+	public:
+		BuilderBuildCost() :
+			_sampleCount(0),
+			_averageBuildTimeNs(0) {
+		}
+
+		long long GetSampleCount() const {
+			return this->_sampleCount.load(std::memory_order_relaxed);
+		}
+
+		std::chrono::nanoseconds GetAverageBuildTime() const {
+			return std::chrono::nanoseconds(this->_averageBuildTimeNs.load(std::memory_order_relaxed));
+		}
+
+		// Records a build, this is a plain mean for the first few samples and then an exponentially weighted
+		// average so that the estimate follows changes in behaviour. Concurrent updates may lose a sample,
+		// which doesn't matter for an estimate
+		void RecordBuild(std::chrono::nanoseconds buildTime) {
+			auto sampleCount = this->_sampleCount.fetch_add(1, std::memory_order_relaxed) + 1;
+			auto average = this->_averageBuildTimeNs.load(std::memory_order_relaxed);
+			auto weight = std::min(sampleCount, 8LL);
+			this->_averageBuildTimeNs.store(average + (buildTime.count() - average) / weight, std::memory_order_relaxed);
+		}
+	};
+
+	// Measured build costs, per object builder, which are used to decide whether a node is cheap enough
+	// that it should be built inline rather than being scheduled as a job of its own (node fusion).
+	//
+	// A node is fused when its builder's average build time is below the fusion threshold, which is the measured
+	// cost of dispatching a job (see RecordSchedulingDelay), clamped to [minimumFusionThreshold,
+	// maximumFusionThreshold]. Fused nodes are built on the worker thread which completed their last dependency,
+	// i.e. in the job of the node which produced their final input, so a chain of cheap nodes runs as a single
+	// job. Only nodes whose final input has a single consumer are fused, the consumers of a node which fans out
+	// are scheduled so that they can run in parallel, and nodes are only fused into jobs which were run by their
+	// own object context's job queue. Whether fusion is used at all is up to each object context (see
+	// ObjectContext::SetFusionEnabled), the model only measures.
+	//
+	// The model is shared between object contexts (GetDefault() unless one is supplied), so the costs learnt
+	// in one run are used from the start of the next.
+	class BuildCostModel {
+	private:
+		struct builderEntry {
+			std::weak_ptr<void> objectBuilder;
+			std::shared_ptr<BuilderBuildCost> buildCost;
+		};
+
+		std::mutex _buildersAccessMutex;
+		std::unordered_map<const void*, builderEntry> _builders;
+		size_t _buildersSweepSize;
+
+		std::atomic<long long> _schedulingDelayNs;
+
+	public:
+		// The bounds of the fusion threshold. The upper bound is kept low, as fusing a node which turns out to be
+		// expensive serialises it behind its producer, whereas scheduling a cheap node only costs the dispatch
+		std::chrono::nanoseconds minimumFusionThreshold;
+		std::chrono::nanoseconds maximumFusionThreshold;
+
+		// The number of builds which must have been measured before a builder is considered for fusion
+		long long minimumSampleCount;
+
+		// The maximum number of nodes which can be fused (nested) within a single job, beyond this nodes are
+		// scheduled as usual so that a long chain doesn't exhaust the stack
+		int maximumFusionDepth;
+
+		BuildCostModel() :
+			_buildersSweepSize(1024),
+			_schedulingDelayNs(0),
+			minimumFusionThreshold(std::chrono::microseconds(1)),
+			maximumFusionThreshold(std::chrono::microseconds(20)),
+			minimumSampleCount(16),
+			maximumFusionDepth(16) {
+		}
+
+		static std::shared_ptr<BuildCostModel> GetDefault() {
+			static std::shared_ptr<BuildCostModel> defaultModel = std::make_shared<BuildCostModel>();
+			return defaultModel;
+		}
+
+		// Returns the cost entry for the builder, which should be looked up once per node rather than per build.
+		// Entries are keyed on the builder's identity, with an entry being reset if the builder it was created
+		// for has since been destroyed (and its address reused)
+		template <class TObjectBuilder>
+		std::shared_ptr<BuilderBuildCost> GetBuilderBuildCost(const std::shared_ptr<TObjectBuilder>& objectBuilder) {
+			std::unique_lock<std::mutex> lock(this->_buildersAccessMutex);
+			auto& entry = this->_builders[(const void*)objectBuilder.get()];
+			if (entry.buildCost && !entry.objectBuilder.expired())
+				return entry.buildCost;
+
+			entry.objectBuilder = objectBuilder;
+			entry.buildCost = std::make_shared<BuilderBuildCost>();
+			auto buildCost = entry.buildCost;
+
+			// Providers which create a builder per address would otherwise grow this indefinitely
+			if (this->_builders.size() > this->_buildersSweepSize) {
+				for (auto itr = this->_builders.begin(); itr != this->_builders.end(); ) {
+					if (itr->second.objectBuilder.expired())
+						itr = this->_builders.erase(itr);
+					else
+						++itr;
+				}
+				this->_buildersSweepSize = std::max((size_t)1024, this->_builders.size() * 2);
+			}
+
+			return buildCost;
+		}
+
+		// Records the delay between a job being registered and it starting. This should only be sampled for jobs
+		// which were registered with an otherwise empty queue, so that it measures the cost of dispatching a job
+		// (waking a worker, etc.) rather than the time spent waiting behind a backlog, which would say nothing
+		// about whether a node is worth scheduling
+		void RecordSchedulingDelay(std::chrono::nanoseconds schedulingDelay) {
+			auto average = this->_schedulingDelayNs.load(std::memory_order_relaxed);
+			this->_schedulingDelayNs.store(average == 0 ? schedulingDelay.count() : average + (schedulingDelay.count() - average) / 16, std::memory_order_relaxed);
+		}
+
+		std::chrono::nanoseconds GetSchedulingDelay() const {
+			return std::chrono::nanoseconds(this->_schedulingDelayNs.load(std::memory_order_relaxed));
+		}
+
+		std::chrono::nanoseconds GetFusionThreshold() const {
+			auto threshold = this->GetSchedulingDelay();
+			if (threshold < this->minimumFusionThreshold)
+				return this->minimumFusionThreshold;
+			if (threshold > this->maximumFusionThreshold)
+				return this->maximumFusionThreshold;
+			return threshold;
+		}
+
+		bool ShouldFuse(const BuilderBuildCost& buildCost) const {
+			if (buildCost.GetSampleCount() < this->minimumSampleCount)
+				return false;
+
+			return buildCost.GetAverageBuildTime() < this->GetFusionThreshold();
+		}
+	};
+
+	// The number of fused nodes currently being built (nested) on the calling thread
+	inline int& currentFusionDepthStorage() {
+		static thread_local int fusionDepth = 0;
+		return fusionDepth;
+	}
+
+	// Whether the calling thread is running the post build call backs of a node with more than one consumer,
+	// in which case the consumers mustn't be fused as they'd then be built one after the other
+	inline bool& currentFusionSuppressedStorage() {
+		static thread_local bool fusionSuppressed = false;
+		return fusionSuppressed;
+	}
+}
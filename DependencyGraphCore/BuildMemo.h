@@ -0,0 +1,275 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "DependencyValues.h"
+#include "IObjectBuilder.h"
+#include "ValueStorage.h"
+
+namespace dependencygraph {
+
+	// A single build within a BuildMemo, i.e. an object builder and the values of its dependencies
+	template <class TKeyType, class TValueType>
+	class BuildMemoEntry {
+	private:
+		template <class TMemoKeyType, class TMemoValueType> friend class BuildMemo;
+
+		size_t _hash;
+		std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> _objectBuilder;
+		std::vector<TValueType> _dependencyValues;
+
+		// Guarded by the memo's lock
+		bool _completed;
+		std::vector<std::function<void(const BuildMemoEntry<TKeyType, TValueType>&)>> _waiters;
+		typename std::list<std::shared_ptr<BuildMemoEntry<TKeyType, TValueType>>>::iterator _recentlyUsedPosition;
+
+		ValueStorage<TValueType> _value;
+
+	public:
+		// Only set once the build has failed
+		std::shared_ptr<std::exception> exception;
+		std::exception_ptr exceptionPtr;
+
+		BuildMemoEntry(size_t hash, const std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder, const DependencyValues<TKeyType, TValueType>& dependencies) :
+			_hash(hash),
+			_objectBuilder(objectBuilder),
+			_completed(false) {
+			this->_dependencyValues.reserve(dependencies.size());
+			for (size_t i = 0; i < dependencies.size(); ++i)
+				this->_dependencyValues.push_back(dependencies.GetValue(i));
+		}
+
+		bool IsSucceeded() const {
+			return this->_value.HasValue();
+		}
+
+		const TValueType& GetValue() const {
+			return this->_value.Get();
+		}
+	};
+
+	// Memo of completed (and in-flight) builds, keyed by the object builder plus the values of the dependencies
+	// rather than by the address, for graphs where many addresses resolve to the same computation (e.g. the
+	// same curve being built for several scenarios). A node whose build matches one which has already been
+	// done takes a copy of its value, and one which matches a build which is in flight is completed along
+	// with it rather than building the object again.
+	//
+	// Only builders which return true from IObjectBuilder::IsMemoizable take part, as the address isn't part
+	// of the key. The memo can be shared between object contexts (see ObjectContext::SetBuildMemo), it holds
+	// a copy of the dependency values for each entry (to guard against hash collisions) and is bounded,
+	// completed entries being evicted least recently used first. Failed builds aren't memoized, although
+	// nodes which were waiting on the build fail along with it.
+	template <class TKeyType, class TValueType>
+	class BuildMemo {
+		static_assert(std::is_copy_constructible<TValueType>::value, "Memoized builds are copied between nodes and so require a copyable value type");
+
+	public:
+		typedef BuildMemoEntry<TKeyType, TValueType> Entry;
+
+	private:
+		std::function<size_t(const TValueType&)> _valueHashFunc;
+		std::function<bool(const TValueType&, const TValueType&)> _valueEqualsFunc;
+		size_t _maximumEntryCount;
+
+		std::mutex _accessMutex;
+		std::unordered_multimap<size_t, std::shared_ptr<Entry>> _entries;
+
+		// Completed entries, most recently used first
+		std::list<std::shared_ptr<Entry>> _recentlyUsedEntries;
+
+		std::atomic<long long> _hitCount;
+		std::atomic<long long> _waitCount;
+		std::atomic<long long> _missCount;
+		std::atomic<long long> _evictionCount;
+
+		size_t hash(const IObjectBuilder<TKeyType, TValueType>* objectBuilder, const DependencyValues<TKeyType, TValueType>& dependencies) const;
+		bool matches(const Entry& entry, const IObjectBuilder<TKeyType, TValueType>* objectBuilder, const DependencyValues<TKeyType, TValueType>& dependencies) const;
+		void remove(const std::shared_ptr<Entry>& entry);
+
+	public:
+		BuildMemo(
+			size_t maximumEntryCount,
+			std::function<size_t(const TValueType&)> valueHashFunc,
+			std::function<bool(const TValueType&, const TValueType&)> valueEqualsFunc) :
+			_valueHashFunc(valueHashFunc),
+			_valueEqualsFunc(valueEqualsFunc),
+			_maximumEntryCount(maximumEntryCount),
+			_hitCount(0),
+			_waitCount(0),
+			_missCount(0),
+			_evictionCount(0) {
+		}
+
+		// Looks up the build of an object by the builder from the dependencies. If the build is new, then the
+		// entry is returned and the caller must build the object, then either SetValue or SetFailed on the entry,
+		// and then Complete it (once it's done with its own node). Otherwise nullptr is returned and onCompleted
+		// is called with the entry once it's complete, which is straight away (on the calling thread) if it
+		// already is, otherwise on the thread which completes it
+		std::shared_ptr<Entry> Acquire(
+			const std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder,
+			const DependencyValues<TKeyType, TValueType>& dependencies,
+			std::function<void(const Entry&)>&& onCompleted);
+
+		void SetValue(const std::shared_ptr<Entry>& entry, const TValueType& value);
+		void SetFailed(const std::shared_ptr<Entry>& entry, std::shared_ptr<std::exception> exception, std::exception_ptr exceptionPtr);
+
+		// Marks the entry as complete and calls anything which was waiting on it
+		void Complete(const std::shared_ptr<Entry>& entry);
+
+		size_t GetEntryCount() {
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			return this->_entries.size();
+		}
+
+		// Builds which were satisfied by a completed entry
+		long long GetHitCount() const {
+			return this->_hitCount.load();
+		}
+
+		// Builds which waited on an entry which was in flight
+		long long GetWaitCount() const {
+			return this->_waitCount.load();
+		}
+
+		// Builds which had to actually be done
+		long long GetMissCount() const {
+			return this->_missCount.load();
+		}
+
+		long long GetEvictionCount() const {
+			return this->_evictionCount.load();
+		}
+	};
+
+	// Creates a build memo which uses std::hash / operator== for the values
+	template <class TKeyType, class TValueType>
+	std::shared_ptr<BuildMemo<TKeyType, TValueType>> MakeBuildMemo(size_t maximumEntryCount) {
+		return std::make_shared<BuildMemo<TKeyType, TValueType>>(
+			maximumEntryCount,
+			[](const TValueType& value) { return std::hash<TValueType>()(value); },
+			[](const TValueType& lhs, const TValueType& rhs) { return lhs == rhs; });
+	}
+
+	template <class TKeyType, class TValueType>
+	size_t BuildMemo<TKeyType, TValueType>::hash(const IObjectBuilder<TKeyType, TValueType>* objectBuilder, const DependencyValues<TKeyType, TValueType>& dependencies) const {
+		auto hash = std::hash<const void*>()(objectBuilder);
+		for (size_t i = 0; i < dependencies.size(); ++i)
+			hash ^= this->_valueHashFunc(dependencies.GetValue(i)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+
+	template <class TKeyType, class TValueType>
+	bool BuildMemo<TKeyType, TValueType>::matches(const Entry& entry, const IObjectBuilder<TKeyType, TValueType>* objectBuilder, const DependencyValues<TKeyType, TValueType>& dependencies) const {
+		if (entry._objectBuilder.get() != objectBuilder || entry._dependencyValues.size() != dependencies.size())
+			return false;
+
+		for (size_t i = 0; i < dependencies.size(); ++i) {
+			if (!this->_valueEqualsFunc(entry._dependencyValues[i], dependencies.GetValue(i)))
+				return false;
+		}
+
+		return true;
+	}
+
+	template <class TKeyType, class TValueType>
+	std::shared_ptr<BuildMemoEntry<TKeyType, TValueType>> BuildMemo<TKeyType, TValueType>::Acquire(
+		const std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder,
+		const DependencyValues<TKeyType, TValueType>& dependencies,
+		std::function<void(const Entry&)>&& onCompleted) {
+		auto hash = this->hash(objectBuilder.get(), dependencies);
+
+		std::shared_ptr<Entry> completedEntry;
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			auto range = this->_entries.equal_range(hash);
+			for (auto itr = range.first; itr != range.second; ++itr) {
+				auto& entry = itr->second;
+				if (!this->matches(*entry, objectBuilder.get(), dependencies))
+					continue;
+
+				if (!entry->_completed) {
+					entry->_waiters.push_back(std::move(onCompleted));
+					this->_waitCount.fetch_add(1);
+					return nullptr;
+				}
+
+				this->_recentlyUsedEntries.splice(this->_recentlyUsedEntries.begin(), this->_recentlyUsedEntries, entry->_recentlyUsedPosition);
+				completedEntry = entry;
+				break;
+			}
+
+			if (!completedEntry) {
+				auto entry = std::make_shared<Entry>(hash, objectBuilder, dependencies);
+				this->_entries.emplace(hash, entry);
+				this->_missCount.fetch_add(1);
+				return entry;
+			}
+		}
+
+		this->_hitCount.fetch_add(1);
+		onCompleted(*completedEntry);
+		return nullptr;
+	}
+
+	template <class TKeyType, class TValueType>
+	void BuildMemo<TKeyType, TValueType>::SetValue(const std::shared_ptr<Entry>& entry, const TValueType& value) {
+		entry->_value.Set(value);
+
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			this->_recentlyUsedEntries.push_front(entry);
+			entry->_recentlyUsedPosition = this->_recentlyUsedEntries.begin();
+
+			while (this->_recentlyUsedEntries.size() > this->_maximumEntryCount) {
+				this->remove(this->_recentlyUsedEntries.back());
+				this->_recentlyUsedEntries.pop_back();
+				this->_evictionCount.fetch_add(1);
+			}
+		}
+	}
+
+	template <class TKeyType, class TValueType>
+	void BuildMemo<TKeyType, TValueType>::SetFailed(const std::shared_ptr<Entry>& entry, std::shared_ptr<std::exception> exception, std::exception_ptr exceptionPtr) {
+		entry->exception = exception;
+		entry->exceptionPtr = exceptionPtr;
+
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			this->remove(entry);
+		}
+	}
+
+	// Removes the entry from the lookup, must be called with the lock held
+	template <class TKeyType, class TValueType>
+	void BuildMemo<TKeyType, TValueType>::remove(const std::shared_ptr<Entry>& entry) {
+		auto range = this->_entries.equal_range(entry->_hash);
+		for (auto itr = range.first; itr != range.second; ++itr) {
+			if (itr->second == entry) {
+				this->_entries.erase(itr);
+				return;
+			}
+		}
+	}
+
+	// The waiters are called outside of the lock as they go on to complete their own nodes
+	template <class TKeyType, class TValueType>
+	void BuildMemo<TKeyType, TValueType>::Complete(const std::shared_ptr<Entry>& entry) {
+		std::vector<std::function<void(const Entry&)>> waiters;
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			entry->_completed = true;
+			waiters.swap(entry->_waiters);
+		}
+
+		for (auto& waiter : waiters)
+			waiter(*entry);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace dependencygraph {
+
+	// Token which allows a client to abandon a build request, either explicitly through Cancel() or
+	// implicitly once the deadline (if any) has passed.
+	//
+	// A token is passed to ObjectContext::BuildObject and is propagated to every node required by that
+	// request. Nodes which are only required by cancelled requests will not be scheduled and will end up
+	// in the ObjectBuildingState::Cancelled state instead.
+	class CancellationToken {
+	private:
+		std::atomic<bool> _cancelRequested;
+		bool _hasDeadline;
+		std::chrono::steady_clock::time_point _deadline;
+
+	public:
+		CancellationToken() :
+			_cancelRequested(false),
+			_hasDeadline(false) {
+		}
+
+		CancellationToken(std::chrono::steady_clock::time_point deadline) :
+			_cancelRequested(false),
+			_hasDeadline(true),
+			_deadline(deadline) {
+		}
+
+		template <class _Rep, class _Period>
+		static std::shared_ptr<CancellationToken> WithTimeout(const std::chrono::duration<_Rep, _Period> timeout) {
+			return std::make_shared<CancellationToken>(std::chrono::steady_clock::now() + timeout);
+		}
+
+		void Cancel() {
+			this->_cancelRequested.store(true);
+		}
+
+		bool IsCancellationRequested() const {
+			if (this->_cancelRequested.load())
+				return true;
+
+			return this->_hasDeadline && std::chrono::steady_clock::now() >= this->_deadline;
+		}
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "IObjectBuilder.h"
+
+namespace dependencygraph {
+
+	// Object builder which always returns a fixed value and has no dependencies.
+	//
+	// This is used to represent overridden values. The object context recognises constant builders (through
+	// IsConstant) and marks the node as built as soon as it's created, without the node ever going through
+	// the job queue.
+	template <class TKeyType, class TValueType>
+	class ConstantObjectBuilder : public IObjectBuilder<TKeyType, TValueType> {
+	public:
+		TValueType value;
+
+		ConstantObjectBuilder(const TValueType& value) : value(value) { }
+		ConstantObjectBuilder(TValueType&& value) : value(std::move(value)) { }
+
+		std::vector<TKeyType> GetDependencies(const TKeyType& address) override {
+			return std::vector<TKeyType>();
+		}
+
+		TValueType BuildObject(const TKeyType& address, const std::unordered_map<TKeyType, TValueType>& dependencies) override {
+			return this->value;
+		}
+
+		TValueType BuildObject(const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) override {
+			return this->value;
+		}
+
+		bool IsConstant() override {
+			return true;
+		}
+	};
+
+	template <class TKeyType, class TValueType>
+	std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> makeConstantObjectBuilder(const TValueType& value, std::true_type valueTypeIsCopyable) {
+		return std::make_shared<ConstantObjectBuilder<TKeyType, TValueType>>(value);
+	}
+
+	template <class TKeyType, class TValueType>
+	std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> makeConstantObjectBuilder(const TValueType& value, std::false_type valueTypeIsCopyable) {
+		throw std::exception("Overrides require a copyable value type");
+	}
+
+	// Creates a constant builder for an override, the value is copied into every node so the value type must
+	// be copyable (use a shared immutable handle, e.g. std::shared_ptr<const T>, for large values)
+	template <class TKeyType, class TValueType>
+	std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> MakeConstantObjectBuilder(const TValueType& value) {
+		return makeConstantObjectBuilder<TKeyType, TValueType>(value, std::integral_constant<bool, std::is_copy_constructible<TValueType>::value>());
+	}
+}
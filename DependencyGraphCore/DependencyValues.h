@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <unordered_map>
+
+namespace dependencygraph {
+
+	// Read-only view over the built values of an object's dependencies.
+	//
+	// The values are borrowed directly from the dependency nodes rather than copied, so building an object
+	// costs nothing per dependency regardless of how large the values are, and move-only value types can
+	// be used. The view (and any references obtained from it) is only valid for the duration of the
+	// BuildObject call.
+	template <class TKeyType, class TValueType>
+	class DependencyValues {
+	private:
+		const TKeyType* _keys;
+		const TValueType* const* _values;
+		size_t _count;
+
+		std::unordered_map<TKeyType, TValueType> toMap(std::true_type) const {
+			std::unordered_map<TKeyType, TValueType> map;
+			for (size_t i = 0; i < this->_count; ++i)
+				map.emplace(this->_keys[i], *this->_values[i]);
+			return map;
+		}
+
+		std::unordered_map<TKeyType, TValueType> toMap(std::false_type) const {
+			throw std::exception("Dependency values cannot be copied");
+		}
+
+	public:
+		DependencyValues(const TKeyType* keys, const TValueType* const* values, size_t count) :
+			_keys(keys),
+			_values(values),
+			_count(count) {
+		}
+
+		size_t size() const {
+			return this->_count;
+		}
+
+		const TKeyType& GetKey(size_t idx) const {
+			return this->_keys[idx];
+		}
+
+		const TValueType& GetValue(size_t idx) const {
+			return *this->_values[idx];
+		}
+
+		// Returns the value for the given dependency, or nullptr if it isn't a dependency
+		const TValueType* TryGetValue(const TKeyType& key) const {
+			for (size_t i = 0; i < this->_count; ++i) {
+				if (this->_keys[i] == key)
+					return this->_values[i];
+			}
+			return nullptr;
+		}
+
+		const TValueType& at(const TKeyType& key) const {
+			auto value = this->TryGetValue(key);
+			if (!value)
+				throw std::exception("Unknown dependency");
+			return *value;
+		}
+
+		// Copies the values into a map as per the original IObjectBuilder interface
+		std::unordered_map<TKeyType, TValueType> ToMap() const {
+			return this->toMap(std::integral_constant<bool, std::is_copy_constructible<TValueType>::value>());
+		}
+	};
+}
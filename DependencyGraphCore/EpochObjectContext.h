@@ -0,0 +1,500 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ConstantObjectBuilder.h"
+#include "IDependencyGraphJobQueue.h"
+#include "IObjectBuilderProvider.h"
+#include "ObjectContext.h"
+
+namespace dependencygraph {
+
+	// Forward definition
+	template <class TKeyType, class TValueType> class EpochObjectContext;
+
+	// A single, immutable once published, version of the graph's values
+	template <class TKeyType, class TValueType>
+	class ObjectContextEpoch {
+	private:
+		friend class EpochObjectContext<TKeyType, TValueType>;
+
+		unsigned long long _epochNumber;
+		std::shared_ptr<ObjectContext<TKeyType, TValueType>> _objectContext;
+
+		// The requested addresses of the epoch, only ever written before the epoch is published so that
+		// readers can access them without taking any locks
+		std::unordered_map<TKeyType, std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>>> _rootNodes;
+		std::atomic<int> _outstandingRootCount;
+
+	public:
+		ObjectContextEpoch(unsigned long long epochNumber, std::shared_ptr<ObjectContext<TKeyType, TValueType>> objectContext) :
+			_epochNumber(epochNumber),
+			_objectContext(objectContext),
+			_outstandingRootCount(0) {
+		}
+
+		unsigned long long GetEpochNumber() const {
+			return this->_epochNumber;
+		}
+
+		// Returns the node for a requested address, or nullptr if the address isn't one of the epoch's roots
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>> GetObjectBuilderInfo(const TKeyType& address) const {
+			auto itr = this->_rootNodes.find(address);
+			if (itr == this->_rootNodes.end())
+				return nullptr;
+
+			return itr->second;
+		}
+
+		// Returns the value for a requested address, or nullptr if it isn't a root or couldn't be built
+		const TValueType* TryGetValue(const TKeyType& address) const {
+			auto itr = this->_rootNodes.find(address);
+			if (itr == this->_rootNodes.end() || itr->second->getState() != ObjectBuildingState::ObjectBuilt)
+				return nullptr;
+
+			return &itr->second->GetBuiltObject();
+		}
+
+		// The underlying context, should only be used for reading nodes which the epoch has already built
+		std::shared_ptr<ObjectContext<TKeyType, TValueType>> GetObjectContext() const {
+			return this->_objectContext;
+		}
+	};
+
+	// A node which has been built by a (non-constant) builder in an earlier epoch
+	template <class TKeyType, class TValueType>
+	struct EpochKnownNode {
+		std::vector<TKeyType> dependencies;
+
+		// The value, held by a constant builder which is handed out to every epoch that carries it forward
+		std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> constantObjectBuilder;
+
+		// The epoch in which the value was built
+		unsigned long long epochNumber;
+	};
+
+	// Object builder provider for a single epoch. Inputs are supplied as constants, nodes which don't depend
+	// (directly or indirectly) on any of the inputs changed since they were last built are carried forward as
+	// constants, from whichever epoch built them, and everything else is resolved through the underlying provider.
+	template <class TKeyType, class TValueType>
+	class EpochObjectBuilderProvider : public IObjectBuilderProvider<TKeyType, TValueType> {
+	private:
+		struct changeCheckFrame {
+			TKeyType key;
+			const std::vector<TKeyType>* dependencies;
+			size_t nextIdx;
+			unsigned long long lastChangedEpoch;
+		};
+
+		// Used for nodes which have never been built, or whose dependencies aren't known
+		static const unsigned long long alwaysChanged = std::numeric_limits<unsigned long long>::max();
+
+		std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> _objectBuilderProvider;
+		std::shared_ptr<const std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>>> _inputs;
+
+		std::mutex _accessMutex;
+		const std::unordered_map<TKeyType, unsigned long long>* _inputChangedEpochs;
+		const std::unordered_map<TKeyType, EpochKnownNode<TKeyType, TValueType>>* _knownNodes;
+		std::unordered_map<TKeyType, unsigned long long> _lastChangedEpochs;
+
+		bool tryEvaluateLeaf(const TKeyType& address, unsigned long long& lastChangedEpoch, const std::vector<TKeyType>*& dependencies);
+		unsigned long long getLastChangedEpoch(const TKeyType& address);
+
+	public:
+		EpochObjectBuilderProvider(
+			std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> objectBuilderProvider,
+			std::shared_ptr<const std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>>> inputs,
+			const std::unordered_map<TKeyType, unsigned long long>* inputChangedEpochs,
+			const std::unordered_map<TKeyType, EpochKnownNode<TKeyType, TValueType>>* knownNodes) :
+			_objectBuilderProvider(objectBuilderProvider),
+			_inputs(inputs),
+			_inputChangedEpochs(inputChangedEpochs),
+			_knownNodes(knownNodes) {
+		}
+
+		// Drops the references to the epoch context's state once the epoch is complete, any addresses which are
+		// requested from the published epoch after this are resolved through the underlying provider
+		void CompleteEpoch() {
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			this->_inputChangedEpochs = nullptr;
+			this->_knownNodes = nullptr;
+			this->_lastChangedEpochs.clear();
+		}
+
+		// IObjectBuilderProvider functionality
+		bool TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) override;
+	};
+
+	// Object context which evaluates the graph in epochs, for graphs whose inputs are updated continuously.
+	//
+	// Input updates are staged through SetInput and are coalesced into a single new epoch by AdvanceEpoch. The
+	// new epoch is computed in the background while readers continue to see the previous complete epoch; it's
+	// only published (atomically) once all of the roots have been built. If AdvanceEpoch is called whilst an
+	// epoch is still being computed, then the updates are held back and are all picked up by a single epoch
+	// once the current one completes, so superseded updates are never computed on their own.
+	//
+	// Only nodes affected by the changed inputs are rebuilt, everything else is carried forward (copied) from
+	// the epoch which last built it, so the value type must be copyable - use a shared immutable handle, e.g.
+	// std::shared_ptr<const T>, for large values. The latest value of every node which has been built is kept
+	// for this, including nodes which are no longer reachable from the roots. Dependencies are assumed to be a
+	// function of the address only.
+	//
+	// Published epochs are reference counted, a reader pins an epoch by holding on to the result of
+	// GetCurrentEpoch and the epoch is reclaimed once the last reader lets go of it.
+	template <class TKeyType, class TValueType>
+	class EpochObjectContext {
+		static_assert(std::is_copy_constructible<TValueType>::value, "Epoch evaluation carries values forward between epochs and so requires a copyable value type");
+
+	public:
+		EpochObjectContext(
+			std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> objectBuilderProvider,
+			std::shared_ptr<IDependencyGraphJobQueue> jobQueue);
+
+		// Adds an address which is to be built in every epoch, from the next epoch onwards
+		void AddRoot(const TKeyType& address);
+
+		// Stages an update to an input, from the next epoch onwards. Repeated updates to the same input before
+		// the next epoch are coalesced
+		void SetInput(const TKeyType& address, TValueType value);
+
+		// Starts computing a new epoch from the staged updates, or defers it until the epoch currently being
+		// computed has been published
+		void AdvanceEpoch();
+
+		// Returns the latest complete epoch, or nullptr if none has been published yet
+		std::shared_ptr<const ObjectContextEpoch<TKeyType, TValueType>> GetCurrentEpoch() const {
+			return std::atomic_load(&this->_currentEpoch);
+		}
+
+		// Blocks until there are no epochs being computed or waiting to be computed. This should be called
+		// before the object is destroyed
+		void WaitForPendingEpochs();
+
+	private:
+		std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> createEpoch();
+		void startEpoch(std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> epoch);
+		void completeEpoch();
+		void releaseRetiredEpochs();
+		void recordBuiltNodes(const ObjectContextEpoch<TKeyType, TValueType>& epoch);
+
+		std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> _objectBuilderProvider;
+		std::shared_ptr<IDependencyGraphJobQueue> _jobQueue;
+
+		std::mutex _accessMutex;
+		std::condition_variable _epochCompletedCV;
+		std::vector<TKeyType> _roots;
+		bool _rootsChanged;
+		std::unordered_map<TKeyType, TValueType> _pendingInputs;
+
+		// The constant builders of the current inputs, copied on write by each epoch which changes them
+		std::shared_ptr<const std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>>> _inputs;
+		std::unordered_map<TKeyType, unsigned long long> _inputChangedEpochs;
+		unsigned long long _lastEpochNumber;
+		bool _epochInProgress;
+		bool _advanceRequested;
+
+		// The last published epoch, only accessed through the atomic shared_ptr functions
+		std::shared_ptr<const ObjectContextEpoch<TKeyType, TValueType>> _currentEpoch;
+		std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> _lastCompleteEpoch;
+		std::shared_ptr<EpochObjectBuilderProvider<TKeyType, TValueType>> _computingProvider;
+
+		// The epoch being computed, held here rather than by its roots' call backs, and the epochs which have
+		// been superseded. Epochs complete within their roots' post build call backs, so superseded epochs are
+		// only released from the caller's thread (see releaseRetiredEpochs) rather than as part of completing
+		std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> _computingEpoch;
+		std::vector<std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>>> _retiredEpochs;
+
+		// The dependencies and latest value of every address which has been built by a (non-constant) builder.
+		// This, and the epochs in which the inputs last changed, are only updated in between epochs, i.e. when
+		// nothing is being discovered, and so don't need their own lock
+		std::unordered_map<TKeyType, EpochKnownNode<TKeyType, TValueType>> _knownNodes;
+	};
+
+	template <class TKeyType, class TValueType>
+	bool EpochObjectBuilderProvider<TKeyType, TValueType>::TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
+		{
+			auto itr = this->_inputs->find(address);
+			if (itr != this->_inputs->end()) {
+				objectBuilder = itr->second;
+				return true;
+			}
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			if (this->_knownNodes) {
+				auto itr = this->_knownNodes->find(address);
+				if (itr != this->_knownNodes->end() && this->getLastChangedEpoch(address) <= itr->second.epochNumber) {
+					objectBuilder = itr->second.constantObjectBuilder;
+					return true;
+				}
+			}
+		}
+
+		return this->_objectBuilderProvider->TryGetObjectBuilder(address, objectBuilder);
+	}
+
+	// Returns true if the answer is known without looking at the address' dependencies
+	template <class TKeyType, class TValueType>
+	bool EpochObjectBuilderProvider<TKeyType, TValueType>::tryEvaluateLeaf(const TKeyType& address, unsigned long long& lastChangedEpoch, const std::vector<TKeyType>*& dependencies) {
+		auto lastChangedItr = this->_lastChangedEpochs.find(address);
+		if (lastChangedItr != this->_lastChangedEpochs.end()) {
+			lastChangedEpoch = lastChangedItr->second;
+			return true;
+		}
+
+		auto inputItr = this->_inputChangedEpochs->find(address);
+		if (inputItr != this->_inputChangedEpochs->end()) {
+			lastChangedEpoch = inputItr->second;
+		}
+		else {
+			// Anything which hasn't been fully built before has to be built
+			auto itr = this->_knownNodes->find(address);
+			if (itr != this->_knownNodes->end()) {
+				dependencies = &itr->second.dependencies;
+				return false;
+			}
+
+			lastChangedEpoch = alwaysChanged;
+		}
+
+		this->_lastChangedEpochs[address] = lastChangedEpoch;
+		return true;
+	}
+
+	// Determines the latest epoch in which any of the inputs which the address depends upon (directly or
+	// indirectly) changed. The walk is done with an explicit stack as the chains of dependencies can be
+	// arbitrarily long.
+	template <class TKeyType, class TValueType>
+	unsigned long long EpochObjectBuilderProvider<TKeyType, TValueType>::getLastChangedEpoch(const TKeyType& address) {
+		unsigned long long lastChangedEpoch(0);
+		const std::vector<TKeyType>* dependencies(nullptr);
+		if (this->tryEvaluateLeaf(address, lastChangedEpoch, dependencies))
+			return lastChangedEpoch;
+
+		std::vector<changeCheckFrame> stack;
+		stack.push_back({ address, dependencies, 0, 0 });
+		while (!stack.empty()) {
+			auto& frame = stack.back();
+			if (frame.lastChangedEpoch == alwaysChanged || frame.nextIdx == frame.dependencies->size()) {
+				auto frameLastChangedEpoch = frame.lastChangedEpoch;
+				this->_lastChangedEpochs[frame.key] = frameLastChangedEpoch;
+				stack.pop_back();
+				if (!stack.empty() && frameLastChangedEpoch > stack.back().lastChangedEpoch)
+					stack.back().lastChangedEpoch = frameLastChangedEpoch;
+				continue;
+			}
+
+			auto& dependency = (*frame.dependencies)[frame.nextIdx++];
+			if (this->tryEvaluateLeaf(dependency, lastChangedEpoch, dependencies)) {
+				if (lastChangedEpoch > frame.lastChangedEpoch)
+					frame.lastChangedEpoch = lastChangedEpoch;
+				continue;
+			}
+
+			// Note that frame is invalidated by this
+			stack.push_back({ dependency, dependencies, 0, 0 });
+		}
+
+		return this->_lastChangedEpochs[address];
+	}
+
+	template <class TKeyType, class TValueType>
+	EpochObjectContext<TKeyType, TValueType>::EpochObjectContext(
+		std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> objectBuilderProvider,
+		std::shared_ptr<IDependencyGraphJobQueue> jobQueue) :
+		_objectBuilderProvider(objectBuilderProvider),
+		_jobQueue(jobQueue),
+		_rootsChanged(false),
+		_inputs(std::make_shared<std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>>>()),
+		_lastEpochNumber(0),
+		_epochInProgress(false),
+		_advanceRequested(false) {
+	}
+
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::AddRoot(const TKeyType& address) {
+		std::unique_lock<std::mutex> lock(this->_accessMutex);
+		this->_roots.push_back(address);
+		this->_rootsChanged = true;
+	}
+
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::SetInput(const TKeyType& address, TValueType value) {
+		std::unique_lock<std::mutex> lock(this->_accessMutex);
+		this->_pendingInputs[address] = std::move(value);
+	}
+
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::AdvanceEpoch() {
+		this->releaseRetiredEpochs();
+
+		std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> epoch;
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			if (this->_epochInProgress) {
+				this->_advanceRequested = true;
+				return;
+			}
+
+			epoch = this->createEpoch();
+		}
+
+		if (epoch)
+			this->startEpoch(epoch);
+	}
+
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::WaitForPendingEpochs() {
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			while (this->_epochInProgress)
+				this->_epochCompletedCV.wait(lock);
+		}
+
+		this->releaseRetiredEpochs();
+	}
+
+	// Releasing an epoch waits for any of its nodes which are still running their call backs (see
+	// ObjectContext's destructor), so this mustn't be called from within them
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::releaseRetiredEpochs() {
+		std::vector<std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>>> retiredEpochs;
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+			retiredEpochs.swap(this->_retiredEpochs);
+		}
+	}
+
+	// Creates the next epoch from the staged updates (if there's anything to do), must be called with the lock held
+	template <class TKeyType, class TValueType>
+	std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> EpochObjectContext<TKeyType, TValueType>::createEpoch() {
+		if (this->_pendingInputs.empty() && !this->_rootsChanged && this->_lastCompleteEpoch)
+			return nullptr;
+
+		auto epochNumber = ++this->_lastEpochNumber;
+		if (!this->_pendingInputs.empty()) {
+			// Each input's constant builder is created once, here, and shared by every epoch until it changes
+			auto inputs = std::make_shared<std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>>>(*this->_inputs);
+			for (auto& pendingInput : this->_pendingInputs) {
+				this->_inputChangedEpochs[pendingInput.first] = epochNumber;
+				(*inputs)[pendingInput.first] = std::make_shared<ConstantObjectBuilder<TKeyType, TValueType>>(std::move(pendingInput.second));
+			}
+
+			this->_pendingInputs.clear();
+			this->_inputs = inputs;
+		}
+
+		this->_computingProvider = std::make_shared<EpochObjectBuilderProvider<TKeyType, TValueType>>(
+			this->_objectBuilderProvider,
+			this->_inputs,
+			&this->_inputChangedEpochs,
+			&this->_knownNodes);
+
+		auto objectContext = std::make_shared<ObjectContext<TKeyType, TValueType>>(this->_computingProvider, this->_jobQueue);
+		auto epoch = std::make_shared<ObjectContextEpoch<TKeyType, TValueType>>(epochNumber, objectContext);
+		for (auto& root : this->_roots)
+			epoch->_rootNodes[root] = nullptr;
+
+		this->_computingEpoch = epoch;
+		this->_rootsChanged = false;
+		this->_epochInProgress = true;
+		return epoch;
+	}
+
+	// Requests all of the roots, this mustn't be called with the lock held as the builds may complete inline
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::startEpoch(std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> epoch) {
+		// Resolve the nodes up front so that the root map is never written to once the first build can complete
+		std::vector<std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>>> rootNodes;
+		rootNodes.reserve(epoch->_rootNodes.size());
+		for (auto& rootNode : epoch->_rootNodes) {
+			rootNode.second = epoch->_objectContext->GetDependencies(rootNode.first);
+			rootNodes.push_back(rootNode.second);
+		}
+
+		// The extra count stops the epoch from completing until all of the roots have been requested
+		epoch->_outstandingRootCount.store((int)rootNodes.size() + 1);
+		auto pEpoch = epoch.get();
+		for (auto& rootNode : rootNodes) {
+			epoch->_objectContext->BuildObject(rootNode->key);
+			rootNode->RegisterPostBuildCallBack([this, pEpoch](ObjectBuilderInfo<TKeyType, TValueType>& builtRoot) {
+				if (pEpoch->_outstandingRootCount.fetch_sub(1) == 1)
+					this->completeEpoch();
+			});
+		}
+
+		if (epoch->_outstandingRootCount.fetch_sub(1) == 1)
+			this->completeEpoch();
+	}
+
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::completeEpoch() {
+		// The epoch is only referenced through the members here, rather than by a local shared_ptr, as this runs
+		// within its roots' call backs and so it mustn't be released on this thread (the computing epoch can't
+		// change until this one has completed)
+		this->recordBuiltNodes(*this->_computingEpoch);
+
+		std::shared_ptr<ObjectContextEpoch<TKeyType, TValueType>> nextEpoch;
+		{
+			std::unique_lock<std::mutex> lock(this->_accessMutex);
+
+			// The previous epoch is no longer needed to compute this one, so it can go as soon as its readers are done
+			if (this->_lastCompleteEpoch)
+				this->_retiredEpochs.push_back(this->_lastCompleteEpoch);
+			this->_computingProvider->CompleteEpoch();
+			this->_computingProvider = nullptr;
+
+			this->_lastCompleteEpoch = std::move(this->_computingEpoch);
+			std::atomic_store(&this->_currentEpoch, std::shared_ptr<const ObjectContextEpoch<TKeyType, TValueType>>(this->_lastCompleteEpoch));
+
+			this->_epochInProgress = false;
+			if (this->_advanceRequested) {
+				this->_advanceRequested = false;
+				nextEpoch = this->createEpoch();
+			}
+
+			if (!nextEpoch)
+				this->_epochCompletedCV.notify_all();
+		}
+
+		if (nextEpoch)
+			this->startEpoch(nextEpoch);
+	}
+
+	// Records the dependencies and value of every node which was actually built in the epoch, so that later
+	// epochs can work out which nodes are affected by their changed inputs and carry the rest forward. Failed
+	// nodes are walked through as well, as the nodes below them may still have been rebuilt
+	template <class TKeyType, class TValueType>
+	void EpochObjectContext<TKeyType, TValueType>::recordBuiltNodes(const ObjectContextEpoch<TKeyType, TValueType>& epoch) {
+		std::unordered_set<ObjectBuilderInfo<TKeyType, TValueType>*> visited;
+		std::vector<ObjectBuilderInfo<TKeyType, TValueType>*> stack;
+		for (auto& rootNode : epoch._rootNodes)
+			stack.push_back(rootNode.second.get());
+
+		while (!stack.empty()) {
+			auto pOBI = stack.back();
+			stack.pop_back();
+			if (!visited.insert(pOBI).second)
+				continue;
+
+			// Constants (inputs, overrides and carried forward values) don't have any dependencies to record
+			if (!pOBI->objectBuilder || pOBI->objectBuilder->IsConstant())
+				continue;
+
+			if (pOBI->getState() == ObjectBuildingState::ObjectBuilt)
+				this->_knownNodes[pOBI->key] = { pOBI->dependencies, MakeConstantObjectBuilder<TKeyType, TValueType>(pOBI->GetBuiltObject()), epoch.GetEpochNumber() };
+
+			for (auto dependencyOBI : pOBI->dependencyNodes)
+				stack.push_back(dependencyOBI);
+		}
+	}
+}
\ No newline at end of file
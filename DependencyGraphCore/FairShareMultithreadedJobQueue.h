@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IDependencyGraphJobQueue.h"
+#include "ThreadPoolConfiguration.h"
+
+namespace dependencygraph {
+
+	// Forward definition
+	class FairShareMultithreadedJobQueue;
+
+	// Point in time snapshot of a tenant's activity
+	struct FairShareTenantStatistics {
+		long long jobsSubmitted;
+		long long jobsCompleted;
+		long long jobsQueued;
+		long long jobsRunning;
+
+		// Time between a job being registered and it starting to run
+		std::chrono::nanoseconds averageQueueLatency;
+		std::chrono::nanoseconds maximumQueueLatency;
+
+		// Total time spent running the tenant's jobs
+		std::chrono::nanoseconds busyTime;
+
+		// Completed jobs per second since the tenant was created
+		double throughput;
+	};
+
+	// A single client's front-end onto a FairShareMultithreadedJobQueue, typically one per object context.
+	//
+	// All state is guarded by the owning queue's mutex, which the tenant shares so that it can outlive the queue.
+	// Once the queue has been destroyed the tenant's statistics can still be read, but jobs can no longer be
+	// registered with it.
+	class FairShareTenantJobQueue : public IDependencyGraphJobQueue {
+	private:
+		friend class FairShareMultithreadedJobQueue;
+
+		struct queuedJob {
+			DependencyGraphJob job;
+			std::chrono::steady_clock::time_point registeredTime;
+		};
+
+		// Cleared (under the mutex) when the owning queue is destroyed
+		FairShareMultithreadedJobQueue* _owner;
+		std::shared_ptr<std::mutex> _queueAccessMutex;
+		std::queue<queuedJob> _jobs;
+
+		double _weight;
+		double _minimumShare;
+
+		// The tenant's progress in weighted time, the tenant with the lowest virtual time goes next
+		double _virtualTime;
+		long long _estimatedJobCostNs;
+		long long _runningCount;
+		bool _removed;
+
+		std::chrono::steady_clock::time_point _createdTime;
+		long long _jobsSubmitted;
+		long long _jobsCompleted;
+		long long _totalQueueLatencyNs;
+		long long _maximumQueueLatencyNs;
+		long long _busyTimeNs;
+
+	public:
+		const std::string name;
+
+		FairShareTenantJobQueue(FairShareMultithreadedJobQueue* owner, std::shared_ptr<std::mutex> queueAccessMutex, const std::string& name, double weight, double minimumShare) :
+			_owner(owner),
+			_queueAccessMutex(queueAccessMutex),
+			_weight(weight),
+			_minimumShare(minimumShare),
+			_virtualTime(0),
+			_estimatedJobCostNs(10000),
+			_runningCount(0),
+			_removed(false),
+			_createdTime(std::chrono::steady_clock::now()),
+			_jobsSubmitted(0),
+			_jobsCompleted(0),
+			_totalQueueLatencyNs(0),
+			_maximumQueueLatencyNs(0),
+			_busyTimeNs(0),
+			name(name) {
+		}
+
+		void RegisterJob(DependencyGraphJob&& job) override;
+		size_t GetQueuedJobCount() override;
+
+		FairShareTenantStatistics GetStatistics();
+
+		// Changes the tenant's relative share of the pool, takes effect from the next job
+		void SetWeight(double weight);
+	};
+
+	// Thread pool which is shared fairly between many clients (tenants), each with their own job queue
+	// front-end.
+	//
+	// Whenever a thread becomes free it runs the next job of the tenant which has received the least
+	// service relative to its weight, with service measured as time spent running the tenant's jobs (so a
+	// tenant with expensive jobs is charged accordingly). A tenant which has been idle resumes at the
+	// current virtual time rather than with banked credit, so a large batch can't monopolise the pool and
+	// every tenant with work makes progress in proportion to its weight.
+	//
+	// A tenant can also be given a minimum share, i.e. a fraction of the pool's threads. Whilst a tenant with
+	// work is running fewer jobs than this, it's picked ahead of the weighted ordering whenever a thread becomes
+	// free. This is a priority rather than a reservation: threads aren't held back for the tenant, so it still
+	// has to wait for a running job to finish, but latency sensitive (interactive) clients get the next free
+	// threads rather than queueing behind tenants with more credit.
+	//
+	// Note that the worker groups of the configuration are only used for thread placement.
+	class FairShareMultithreadedJobQueue {
+	private:
+		friend class FairShareTenantJobQueue;
+
+		std::vector<std::thread> _threads;
+		int _threadCount;
+
+		std::shared_ptr<std::mutex> _queueAccessMutex;
+		std::condition_variable _queueAccessCV;
+		std::vector<std::shared_ptr<FairShareTenantJobQueue>> _tenants;
+		double _globalVirtualTime;
+		volatile bool _stopRequested;
+
+		void registerJob(FairShareTenantJobQueue* tenant, DependencyGraphJob&& job);
+		FairShareTenantJobQueue* selectTenant();
+		void runWorker();
+
+	public:
+		FairShareMultithreadedJobQueue(int threadCount);
+		FairShareMultithreadedJobQueue(const ThreadPoolConfiguration& configuration);
+
+		~FairShareMultithreadedJobQueue();
+		void StopThreads();
+
+		// Creates a new front-end. The weight determines the tenant's share of the pool relative to the other
+		// busy tenants. The minimum share (0 - 1) is the fraction of the threads which the tenant is given
+		// priority for when it has work, rather than being a number of threads reserved for it
+		std::shared_ptr<FairShareTenantJobQueue> CreateTenant(const std::string& name, double weight = 1.0, double minimumShare = 0.0);
+
+		// Detaches the tenant from the pool once any jobs it has outstanding have completed
+		void RemoveTenant(const std::shared_ptr<FairShareTenantJobQueue>& tenant);
+	};
+
+	inline void FairShareTenantJobQueue::RegisterJob(DependencyGraphJob&& job) {
+		std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+		if (this->_removed)
+			throw std::exception("Jobs cannot be registered with a tenant which has been removed");
+
+		if (!this->_owner)
+			throw std::exception("Jobs cannot be registered with a tenant whose job queue has been destroyed");
+
+		this->_owner->registerJob(this, std::move(job));
+	}
+
+	inline size_t FairShareTenantJobQueue::GetQueuedJobCount() {
+		std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+		return this->_jobs.size();
+	}
+
+	inline FairShareTenantStatistics FairShareTenantJobQueue::GetStatistics() {
+		std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+
+		FairShareTenantStatistics statistics;
+		statistics.jobsSubmitted = this->_jobsSubmitted;
+		statistics.jobsCompleted = this->_jobsCompleted;
+		statistics.jobsQueued = (long long)this->_jobs.size();
+		statistics.jobsRunning = this->_runningCount;
+
+		auto startedCount = this->_jobsCompleted + this->_runningCount;
+		statistics.averageQueueLatency = std::chrono::nanoseconds(startedCount > 0 ? this->_totalQueueLatencyNs / startedCount : 0);
+		statistics.maximumQueueLatency = std::chrono::nanoseconds(this->_maximumQueueLatencyNs);
+		statistics.busyTime = std::chrono::nanoseconds(this->_busyTimeNs);
+
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->_createdTime).count();
+		statistics.throughput = elapsed > 0 ? this->_jobsCompleted / elapsed : 0;
+		return statistics;
+	}
+
+	inline void FairShareTenantJobQueue::SetWeight(double weight) {
+		if (weight <= 0)
+			throw std::exception("Tenant weights must be positive");
+
+		std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+		this->_weight = weight;
+	}
+
+	inline FairShareMultithreadedJobQueue::FairShareMultithreadedJobQueue(int threadCount) :
+		FairShareMultithreadedJobQueue(ThreadPoolConfiguration::FromThreadCount(threadCount)) {
+	}
+
+	inline FairShareMultithreadedJobQueue::FairShareMultithreadedJobQueue(const ThreadPoolConfiguration& configuration) :
+		_threadCount(configuration.GetTotalThreadCount()),
+		_queueAccessMutex(std::make_shared<std::mutex>()),
+		_globalVirtualTime(0),
+		_stopRequested(false) {
+		if (this->_threadCount <= 0)
+			throw std::exception("Invalid thread count specified");
+
+		for (int workerGroupIdx(0); workerGroupIdx < (int)configuration.workerGroups.size(); ++workerGroupIdx) {
+			for (int i(0); i < configuration.workerGroups[workerGroupIdx].threadCount; ++i) {
+				_threads.push_back(std::thread([this, configuration, workerGroupIdx, i]() -> void {
+					ApplyWorkerPlacement(configuration, workerGroupIdx, i);
+					this->runWorker();
+					}));
+			}
+		}
+	}
+
+	inline std::shared_ptr<FairShareTenantJobQueue> FairShareMultithreadedJobQueue::CreateTenant(const std::string& name, double weight, double minimumShare) {
+		if (weight <= 0)
+			throw std::exception("Tenant weights must be positive");
+
+		if (minimumShare < 0 || minimumShare > 1)
+			throw std::exception("Minimum shares must be between 0 and 1");
+
+		auto tenant = std::make_shared<FairShareTenantJobQueue>(this, this->_queueAccessMutex, name, weight, minimumShare);
+
+		std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+		tenant->_virtualTime = this->_globalVirtualTime;
+		this->_tenants.push_back(tenant);
+		return tenant;
+	}
+
+	inline void FairShareMultithreadedJobQueue::RemoveTenant(const std::shared_ptr<FairShareTenantJobQueue>& tenant) {
+		std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+		tenant->_removed = true;
+		if (tenant->_jobs.empty() && tenant->_runningCount == 0)
+			this->_tenants.erase(std::remove(this->_tenants.begin(), this->_tenants.end(), tenant), this->_tenants.end());
+	}
+
+	// Must be called with the queue access mutex held
+	inline void FairShareMultithreadedJobQueue::registerJob(FairShareTenantJobQueue* tenant, DependencyGraphJob&& job) {
+		// A tenant which has been idle doesn't get to catch up on the service it didn't use
+		if (tenant->_jobs.empty() && tenant->_runningCount == 0)
+			tenant->_virtualTime = std::max(tenant->_virtualTime, this->_globalVirtualTime);
+
+		FairShareTenantJobQueue::queuedJob queuedJob;
+		queuedJob.job = std::move(job);
+		queuedJob.registeredTime = std::chrono::steady_clock::now();
+		tenant->_jobs.push(std::move(queuedJob));
+		tenant->_jobsSubmitted++;
+
+		this->_queueAccessCV.notify_one();
+	}
+
+	// Returns the tenant whose job should run next, or nullptr if there's nothing to do. Must be called with
+	// the queue access mutex held
+	inline FairShareTenantJobQueue* FairShareMultithreadedJobQueue::selectTenant() {
+		FairShareTenantJobQueue* selected(nullptr);
+		bool selectedIsBelowMinimum(false);
+		for (auto& tenant : this->_tenants) {
+			if (tenant->_jobs.empty())
+				continue;
+
+			auto reservedThreads = (long long)std::ceil(tenant->_minimumShare * this->_threadCount);
+			bool isBelowMinimum = tenant->_runningCount < reservedThreads;
+
+			if (!selected ||
+				(isBelowMinimum && !selectedIsBelowMinimum) ||
+				(isBelowMinimum == selectedIsBelowMinimum && tenant->_virtualTime < selected->_virtualTime)) {
+				selected = tenant.get();
+				selectedIsBelowMinimum = isBelowMinimum;
+			}
+		}
+
+		return selected;
+	}
+
+	inline void FairShareMultithreadedJobQueue::runWorker() {
+		while (true) {
+			try {
+				if (_stopRequested)
+					return;
+
+				std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+				auto tenant = this->selectTenant();
+				if (!tenant) {
+					// Nothing to do
+					if (_stopRequested)
+						return;
+
+					this->_queueAccessCV.wait(lock);
+					continue;
+				}
+
+				auto queuedJob = std::move(tenant->_jobs.front());
+				tenant->_jobs.pop();
+				tenant->_runningCount++;
+
+				// Charge the tenant up front with the estimated cost so that it doesn't get every free thread
+				// before any of its jobs have completed, this is corrected once the actual cost is known
+				this->_globalVirtualTime = std::max(this->_globalVirtualTime, tenant->_virtualTime);
+				auto estimatedJobCostNs = tenant->_estimatedJobCostNs;
+				tenant->_virtualTime += estimatedJobCostNs / tenant->_weight;
+
+				auto startTime = std::chrono::steady_clock::now();
+				auto queueLatencyNs = (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - queuedJob.registeredTime).count();
+				tenant->_totalQueueLatencyNs += queueLatencyNs;
+				tenant->_maximumQueueLatencyNs = std::max(tenant->_maximumQueueLatencyNs, queueLatencyNs);
+				lock.unlock();
+
+				SetCurrentJobQueue(tenant);
+				try
+				{
+					if (queuedJob.job.func)
+						queuedJob.job.func();
+				}
+				catch (...) {
+					// What to do here?
+				}
+				SetCurrentJobQueue(nullptr);
+
+				auto jobCostNs = (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+				lock.lock();
+				tenant->_runningCount--;
+				tenant->_jobsCompleted++;
+				tenant->_busyTimeNs += jobCostNs;
+				tenant->_virtualTime += (jobCostNs - estimatedJobCostNs) / tenant->_weight;
+				tenant->_estimatedJobCostNs = std::max(1LL, tenant->_estimatedJobCostNs + (jobCostNs - tenant->_estimatedJobCostNs) / 8);
+
+				if (tenant->_removed && tenant->_jobs.empty() && tenant->_runningCount == 0) {
+					this->_tenants.erase(std::remove_if(this->_tenants.begin(), this->_tenants.end(), [tenant](const std::shared_ptr<FairShareTenantJobQueue>& t) { return t.get() == tenant; }), this->_tenants.end());
+				}
+			}
+			catch (...) {
+
+			}
+		}
+	}
+
+	inline void FairShareMultithreadedJobQueue::StopThreads() {
+		{
+			std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+			this->_stopRequested = true;
+			this->_queueAccessCV.notify_all();
+		}
+
+		for (auto& t : this->_threads) {
+			t.join();
+		}
+
+		this->_threads.clear();
+	}
+
+	// Any tenants which are still referenced elsewhere are detached, so that they reject new jobs rather than
+	// referring to the destroyed queue
+	inline FairShareMultithreadedJobQueue::~FairShareMultithreadedJobQueue() {
+		this->StopThreads();
+
+		std::unique_lock<std::mutex> lock(*this->_queueAccessMutex);
+		for (auto& tenant : this->_tenants)
+			tenant->_owner = nullptr;
+		this->_tenants.clear();
+	}
+}
@@ -0,0 +1,466 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "ObjectContext.h"
+
+namespace dependencygraph {
+
+	// How the keys are written to / read from a persisted topology. Trivially copyable keys and strings are
+	// handled here, other key types need to specialise this
+	template <class TKeyType, class Enable = void>
+	struct TopologyKeySerializer;
+
+	template <class TKeyType>
+	struct TopologyKeySerializer<TKeyType, typename std::enable_if<std::is_trivially_copyable<TKeyType>::value>::type> {
+		static void Write(const TKeyType& key, std::string& buffer) {
+			buffer.append((const char*)&key, sizeof(TKeyType));
+		}
+
+		static TKeyType Read(const char* data, size_t size) {
+			if (size != sizeof(TKeyType))
+				throw std::exception("Invalid key in topology");
+
+			TKeyType key;
+			std::memcpy(&key, data, sizeof(TKeyType));
+			return key;
+		}
+	};
+
+	template <class TChar>
+	struct TopologyKeySerializer<std::basic_string<TChar>> {
+		static void Write(const std::basic_string<TChar>& key, std::string& buffer) {
+			buffer.append((const char*)key.data(), key.size() * sizeof(TChar));
+		}
+
+		static std::basic_string<TChar> Read(const char* data, size_t size) {
+			if (size % sizeof(TChar) != 0)
+				throw std::exception("Invalid key in topology");
+
+			std::basic_string<TChar> key(size / sizeof(TChar), TChar());
+			std::memcpy(&key[0], data, size);
+			return key;
+		}
+	};
+
+	// How much of a persisted topology is checked against the provider / builders when it's loaded. Any node
+	// which doesn't match is left to be discovered as usual
+	enum class TopologyValidation {
+		// The topology is trusted as is, i.e. nothing in the graph's definition has changed since it was saved
+		none,
+
+		// Each node's builder is checked against the provider's (cheap, but misses changed dependencies). The
+		// builders are compared by identity, i.e. the builder returned for an id must be the same instance as
+		// the provider returns, so providers which create a new builder on each lookup always fail it
+		builders,
+
+		// As builders, plus each node's dependencies are checked against GetDependencies. Still avoids the
+		// hash lookups and node creation of discovery, but not the cost of GetDependencies itself
+		full,
+	};
+
+	// Read only view over a persisted topology (see SaveTopology), which is laid out so that it can be used in
+	// place, e.g. straight from a memory mapped file:
+	//
+	//	header
+	//	builder table - offset / size of each builder's id within the blob
+	//	node table - offset / size of each node's key within the blob, plus the index of its builder
+	//	edge offsets - (node count + 1) offsets into the edges, node i's dependencies being [offsets[i], offsets[i + 1])
+	//	edges - the index of each dependency's node
+	//	blob - the builder ids and keys
+	//
+	// All of the fields are fixed width (in the native byte order) and each section is 8 byte aligned. The
+	// layout is checked when the view is created, but the data must outlive the view and be 8 byte aligned
+	class GraphTopologyView {
+	public:
+		static const std::uint32_t noBuilder = 0xFFFFFFFF;
+
+		struct Header {
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t byteOrderMark;
+			std::uint64_t nodeCount;
+			std::uint64_t edgeCount;
+			std::uint64_t builderCount;
+			std::uint64_t buildersOffset;
+			std::uint64_t nodesOffset;
+			std::uint64_t edgeOffsetsOffset;
+			std::uint64_t edgesOffset;
+			std::uint64_t blobOffset;
+			std::uint64_t blobSize;
+		};
+
+		struct BuilderRecord {
+			std::uint64_t idOffset;
+			std::uint64_t idSize;
+		};
+
+		struct NodeRecord {
+			std::uint64_t keyOffset;
+			std::uint32_t keySize;
+
+			// noBuilder if the node wasn't discovered (or its builder couldn't be persisted)
+			std::uint32_t builderIndex;
+		};
+
+		static const char* Magic() {
+			return "DGTOPOLY";
+		}
+
+		static const std::uint32_t currentVersion = 1;
+		static const std::uint32_t byteOrderMark = 0x01020304;
+
+	private:
+		const char* _data;
+		const Header* _header;
+		const BuilderRecord* _builders;
+		const NodeRecord* _nodes;
+		const std::uint64_t* _edgeOffsets;
+		const std::uint32_t* _edges;
+		const char* _blob;
+
+		static bool isSectionValid(std::uint64_t offset, std::uint64_t count, std::uint64_t elementSize, size_t size) {
+			return offset % 8 == 0 && offset <= size && count <= (size - offset) / elementSize;
+		}
+
+	public:
+		GraphTopologyView(const char* data, size_t size);
+
+		size_t GetNodeCount() const {
+			return (size_t)this->_header->nodeCount;
+		}
+
+		size_t GetEdgeCount() const {
+			return (size_t)this->_header->edgeCount;
+		}
+
+		size_t GetBuilderCount() const {
+			return (size_t)this->_header->builderCount;
+		}
+
+		std::string GetBuilderId(size_t builderIndex) const {
+			auto& builder = this->_builders[builderIndex];
+			return std::string(this->_blob + builder.idOffset, (size_t)builder.idSize);
+		}
+
+		const NodeRecord& GetNode(size_t nodeIndex) const {
+			return this->_nodes[nodeIndex];
+		}
+
+		template <class TKeyType>
+		TKeyType GetNodeKey(size_t nodeIndex) const {
+			auto& node = this->_nodes[nodeIndex];
+			return TopologyKeySerializer<TKeyType>::Read(this->_blob + node.keyOffset, node.keySize);
+		}
+
+		const std::uint64_t* GetEdgeOffsets() const {
+			return this->_edgeOffsets;
+		}
+
+		const std::uint32_t* GetEdges() const {
+			return this->_edges;
+		}
+	};
+
+	inline GraphTopologyView::GraphTopologyView(const char* data, size_t size) :
+		_data(data) {
+		if (size < sizeof(Header) || ((std::uintptr_t)data % 8) != 0)
+			throw std::exception("Invalid topology");
+
+		this->_header = (const Header*)data;
+		if (std::memcmp(this->_header->magic, Magic(), sizeof(this->_header->magic)) != 0 || this->_header->byteOrderMark != byteOrderMark)
+			throw std::exception("Invalid topology");
+
+		if (this->_header->version != currentVersion)
+			throw std::exception("Unsupported topology version");
+
+		auto& header = *this->_header;
+		if (header.nodeCount >= noBuilder ||
+			header.builderCount >= noBuilder ||
+			!isSectionValid(header.buildersOffset, header.builderCount, sizeof(BuilderRecord), size) ||
+			!isSectionValid(header.nodesOffset, header.nodeCount, sizeof(NodeRecord), size) ||
+			!isSectionValid(header.edgeOffsetsOffset, header.nodeCount + 1, sizeof(std::uint64_t), size) ||
+			!isSectionValid(header.edgesOffset, header.edgeCount, sizeof(std::uint32_t), size) ||
+			!isSectionValid(header.blobOffset, header.blobSize, 1, size))
+			throw std::exception("Invalid topology");
+
+		this->_builders = (const BuilderRecord*)(data + header.buildersOffset);
+		this->_nodes = (const NodeRecord*)(data + header.nodesOffset);
+		this->_edgeOffsets = (const std::uint64_t*)(data + header.edgeOffsetsOffset);
+		this->_edges = (const std::uint32_t*)(data + header.edgesOffset);
+		this->_blob = data + header.blobOffset;
+
+		for (std::uint64_t i = 0; i < header.builderCount; ++i) {
+			if (this->_builders[i].idOffset > header.blobSize || this->_builders[i].idSize > header.blobSize - this->_builders[i].idOffset)
+				throw std::exception("Invalid topology");
+		}
+
+		for (std::uint64_t i = 0; i < header.nodeCount; ++i) {
+			auto& node = this->_nodes[i];
+			if (node.keyOffset > header.blobSize || node.keySize > header.blobSize - node.keyOffset)
+				throw std::exception("Invalid topology");
+
+			if (node.builderIndex != noBuilder && node.builderIndex >= header.builderCount)
+				throw std::exception("Invalid topology");
+
+			if (this->_edgeOffsets[i] > this->_edgeOffsets[i + 1])
+				throw std::exception("Invalid topology");
+		}
+
+		if (this->_edgeOffsets[0] != 0 || this->_edgeOffsets[header.nodeCount] != header.edgeCount)
+			throw std::exception("Invalid topology");
+
+		for (std::uint64_t i = 0; i < header.edgeCount; ++i) {
+			if (this->_edges[i] >= header.nodeCount)
+				throw std::exception("Invalid topology");
+		}
+	}
+
+	// The outcome of loading a persisted topology into an object context
+	struct TopologyLoadResult {
+	public:
+		// Nodes which were marked as discovered straight from the topology
+		size_t restoredNodeCount;
+
+		// Nodes which were only created, and will be discovered as usual when needed, i.e. those which hadn't
+		// been discovered when the topology was saved, whose builder couldn't be resolved or which failed
+		// validation
+		size_t undiscoveredNodeCount;
+
+		// Of the undiscovered nodes, those which failed validation
+		size_t invalidNodeCount;
+
+		TopologyLoadResult() :
+			restoredNodeCount(0),
+			undiscoveredNodeCount(0),
+			invalidNodeCount(0) {
+		}
+	};
+
+	// Persists the topology of an object context, i.e. the keys of its nodes, their builders and the edges
+	// between them, so that a new context (e.g. in a freshly started process) can be restored from it with
+	// LoadTopology rather than discovering the graph one node at a time.
+	//
+	// Builders are persisted by id, builderIdFunc (const std::shared_ptr<IObjectBuilder>& -> std::string) being
+	// called once per distinct builder, and an empty id meaning that the builder can't be persisted (the nodes
+	// using it are then rediscovered). Only nodes whose dependencies are known are persisted as discovered,
+	// constant builders (overrides) and failed nodes are left to be rediscovered. The context shouldn't be
+	// being discovered whilst it's being saved.
+	template <class TKeyType, class TValueType, class TBuilderPolicy, class TBuilderIdFunc>
+	void SaveTopology(ObjectContext<TKeyType, TValueType, TBuilderPolicy>& objectContext, std::ostream& stream, TBuilderIdFunc builderIdFunc) {
+		typedef ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy> node;
+		typedef GraphTopologyView view;
+
+		auto nodes = objectContext.GetKnownNodes();
+		if (nodes.size() >= view::noBuilder)
+			throw std::exception("Too many nodes to persist");
+
+		std::unordered_map<const node*, std::uint32_t> nodeIndices;
+		nodeIndices.reserve(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i)
+			nodeIndices[nodes[i].get()] = (std::uint32_t)i;
+
+		std::string blob;
+		std::vector<view::BuilderRecord> builderRecords;
+		std::unordered_map<const IObjectBuilder<TKeyType, TValueType>*, std::uint32_t> builderIndices;
+		std::vector<view::NodeRecord> nodeRecords(nodes.size());
+		std::vector<std::uint64_t> edgeOffsets(nodes.size() + 1, 0);
+		std::vector<std::uint32_t> edges;
+
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			auto& objectBuilderInfo = *nodes[i];
+			auto& nodeRecord = nodeRecords[i];
+
+			nodeRecord.keyOffset = blob.size();
+			TopologyKeySerializer<TKeyType>::Write(objectBuilderInfo.key, blob);
+			nodeRecord.keySize = (std::uint32_t)(blob.size() - nodeRecord.keyOffset);
+			nodeRecord.builderIndex = view::noBuilder;
+
+			switch (objectBuilderInfo.getState()) {
+			case ObjectBuildingState::DependenciesKnown:
+			case ObjectBuildingState::Building:
+			case ObjectBuildingState::ObjectBuilt:
+			case ObjectBuildingState::Cancelled:
+				break;
+
+			default:
+				edgeOffsets[i + 1] = edges.size();
+				continue;
+			}
+
+			auto& objectBuilder = objectBuilderInfo.objectBuilder;
+			if (objectBuilder && !objectBuilder->IsConstant()) {
+				auto builderItr = builderIndices.find(objectBuilder.get());
+				if (builderItr == builderIndices.end()) {
+					std::string builderId = builderIdFunc(objectBuilder);
+					auto builderIndex = view::noBuilder;
+					if (!builderId.empty()) {
+						builderIndex = (std::uint32_t)builderRecords.size();
+						view::BuilderRecord builderRecord;
+						builderRecord.idOffset = blob.size();
+						builderRecord.idSize = builderId.size();
+						builderRecords.push_back(builderRecord);
+						blob.append(builderId);
+					}
+					builderItr = builderIndices.emplace(objectBuilder.get(), builderIndex).first;
+				}
+				nodeRecord.builderIndex = builderItr->second;
+			}
+
+			if (nodeRecord.builderIndex != view::noBuilder) {
+				for (auto dependencyOBI : objectBuilderInfo.dependencyNodes)
+					edges.push_back(nodeIndices[dependencyOBI]);
+			}
+			edgeOffsets[i + 1] = edges.size();
+		}
+
+		auto align = [](std::uint64_t offset) { return (offset + 7) & ~(std::uint64_t)7; };
+
+		view::Header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, view::Magic(), sizeof(header.magic));
+		header.version = view::currentVersion;
+		header.byteOrderMark = view::byteOrderMark;
+		header.nodeCount = nodes.size();
+		header.edgeCount = edges.size();
+		header.builderCount = builderRecords.size();
+		header.buildersOffset = align(sizeof(header));
+		header.nodesOffset = align(header.buildersOffset + builderRecords.size() * sizeof(view::BuilderRecord));
+		header.edgeOffsetsOffset = align(header.nodesOffset + nodeRecords.size() * sizeof(view::NodeRecord));
+		header.edgesOffset = align(header.edgeOffsetsOffset + edgeOffsets.size() * sizeof(std::uint64_t));
+		header.blobOffset = align(header.edgesOffset + edges.size() * sizeof(std::uint32_t));
+		header.blobSize = blob.size();
+
+		std::uint64_t written(0);
+		auto write = [&stream, &written](std::uint64_t offset, const void* data, std::uint64_t size) {
+			static const char padding[8] = { 0 };
+			stream.write(padding, (std::streamsize)(offset - written));
+			stream.write((const char*)data, (std::streamsize)size);
+			written = offset + size;
+		};
+
+		write(0, &header, sizeof(header));
+		write(header.buildersOffset, builderRecords.data(), builderRecords.size() * sizeof(view::BuilderRecord));
+		write(header.nodesOffset, nodeRecords.data(), nodeRecords.size() * sizeof(view::NodeRecord));
+		write(header.edgeOffsetsOffset, edgeOffsets.data(), edgeOffsets.size() * sizeof(std::uint64_t));
+		write(header.edgesOffset, edges.data(), edges.size() * sizeof(std::uint32_t));
+		write(header.blobOffset, blob.data(), blob.size());
+
+		if (!stream)
+			throw std::exception("Failed to write topology");
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy, class TBuilderIdFunc>
+	void SaveTopology(ObjectContext<TKeyType, TValueType, TBuilderPolicy>& objectContext, const std::string& fileName, TBuilderIdFunc builderIdFunc) {
+		std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+		if (!stream)
+			throw std::exception("Failed to open topology file");
+
+		SaveTopology(objectContext, stream, builderIdFunc);
+	}
+
+	// Restores a persisted topology (see SaveTopology) into an object context, creating all of its nodes and
+	// marking those which had been discovered as such, so that building them goes straight to scheduling.
+	// objectBuilderFunc (const std::string& -> std::shared_ptr<IObjectBuilder>) maps the builder ids back to
+	// builders, being called once per distinct id, with nullptr meaning that the id is no longer known (the
+	// nodes using it are then rediscovered). The context's provider is only consulted for its overrides (which
+	// are always respected) and, if validation is asked for, its builders. The data must be 8 byte aligned and is only used during the call, so may be memory mapped.
+	//
+	// Should be called before any objects are requested. Nodes which the context has already discovered are
+	// left as they are
+	template <class TKeyType, class TValueType, class TBuilderPolicy, class TObjectBuilderFunc>
+	TopologyLoadResult LoadTopology(
+		ObjectContext<TKeyType, TValueType, TBuilderPolicy>& objectContext,
+		const char* data,
+		size_t size,
+		TObjectBuilderFunc objectBuilderFunc,
+		TopologyValidation validation = TopologyValidation::none) {
+		GraphTopologyView topology(data, size);
+
+		std::vector<std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> builders(topology.GetBuilderCount());
+		for (size_t i = 0; i < builders.size(); ++i)
+			builders[i] = objectBuilderFunc(topology.GetBuilderId(i));
+
+		std::vector<TKeyType> addresses;
+		std::vector<std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> objectBuilders(topology.GetNodeCount());
+		addresses.reserve(topology.GetNodeCount());
+		for (size_t i = 0; i < topology.GetNodeCount(); ++i) {
+			addresses.push_back(topology.GetNodeKey<TKeyType>(i));
+
+			auto builderIndex = topology.GetNode(i).builderIndex;
+			if (builderIndex != GraphTopologyView::noBuilder)
+				objectBuilders[i] = builders[builderIndex];
+		}
+
+		TopologyLoadResult result;
+		if (validation != TopologyValidation::none) {
+			auto objectBuilderProvider = objectContext.GetObjectBuilderProvider();
+			auto edgeOffsets = topology.GetEdgeOffsets();
+			auto edges = topology.GetEdges();
+
+			for (size_t i = 0; i < addresses.size(); ++i) {
+				if (!objectBuilders[i])
+					continue;
+
+				bool isValid(false);
+				try
+				{
+					std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder;
+					isValid = objectBuilderProvider->TryGetObjectBuilder(addresses[i], objectBuilder) && objectBuilder == objectBuilders[i];
+
+					if (isValid && validation == TopologyValidation::full) {
+						auto dependencies = objectBuilder->GetDependencies(addresses[i]);
+						isValid = dependencies.size() == edgeOffsets[i + 1] - edgeOffsets[i];
+						for (size_t j = 0; isValid && j < dependencies.size(); ++j)
+							isValid = dependencies[j] == addresses[edges[edgeOffsets[i] + j]];
+					}
+				}
+				catch (...)
+				{
+					// Left for discovery to report
+					isValid = false;
+				}
+
+				if (!isValid) {
+					objectBuilders[i] = nullptr;
+					result.invalidNodeCount++;
+				}
+			}
+		}
+
+		result.restoredNodeCount = objectContext.RestoreDiscoveredNodes(addresses, objectBuilders, topology.GetEdgeOffsets(), topology.GetEdges());
+		result.undiscoveredNodeCount = addresses.size() - result.restoredNodeCount;
+		return result;
+	}
+
+	// Loads a persisted topology from a file (see above), reading it in one go. Where the start up time matters
+	// most, the file can instead be memory mapped and passed to LoadTopology directly
+	template <class TKeyType, class TValueType, class TBuilderPolicy, class TObjectBuilderFunc>
+	TopologyLoadResult LoadTopology(
+		ObjectContext<TKeyType, TValueType, TBuilderPolicy>& objectContext,
+		const std::string& fileName,
+		TObjectBuilderFunc objectBuilderFunc,
+		TopologyValidation validation = TopologyValidation::none) {
+		std::ifstream stream(fileName, std::ios::binary | std::ios::ate);
+		if (!stream)
+			throw std::exception("Failed to open topology file");
+
+		auto size = (size_t)stream.tellg();
+		stream.seekg(0);
+
+		// Held as 64 bit words so that the sections are aligned
+		std::vector<std::uint64_t> buffer((size + 7) / 8);
+		if (!stream.read((char*)buffer.data(), (std::streamsize)size))
+			throw std::exception("Failed to read topology file");
+
+		return LoadTopology(objectContext, (const char*)buffer.data(), size, objectBuilderFunc, validation);
+	}
+}
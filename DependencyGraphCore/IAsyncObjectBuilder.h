@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "IObjectBuilder.h"
+#include "ValueStorage.h"
+
+namespace dependencygraph {
+
+	// Handle through which an asynchronous build reports its outcome, exactly one of the methods should be
+	// called (any further calls are ignored) and they may be called from any thread
+	template <class TValueType>
+	class IAsyncBuildCompletion {
+	public:
+		virtual void SetResult(TValueType&& value) = 0;
+		virtual void SetFailed(std::shared_ptr<std::exception> exception) = 0;
+
+		// As above, but with the original exception (e.g. std::current_exception()) so that it's logged and
+		// rethrown with its actual type. Either may be null
+		virtual void SetFailed(std::shared_ptr<std::exception> exception, std::exception_ptr exceptionPtr) = 0;
+	};
+
+	// Object builder which builds its objects asynchronously, e.g. loading them from disk or requesting them
+	// from a service.
+	//
+	// The node is left in the ObjectBuildingState::Building state, without a job queue thread attached, from
+	// the point that BuildObjectAsync returns until the completion is called. Dependent nodes are then
+	// scheduled from whichever thread calls the completion. This allows a small number of threads to keep a
+	// large number of such builds in flight. The completion may be held on to after the node's object context
+	// has been destroyed, in which case its outcome is ignored.
+	template <class TKeyType, class TValueType>
+	class IAsyncObjectBuilder : public IObjectBuilder<TKeyType, TValueType> {
+	private:
+		class blockingCompletion : public IAsyncBuildCompletion<TValueType> {
+		private:
+			std::mutex _mutex;
+			std::condition_variable _cv;
+			bool _completed;
+			ValueStorage<TValueType> _value;
+			std::exception_ptr _exceptionPtr;
+
+		public:
+			blockingCompletion() : _completed(false) { }
+
+			void SetResult(TValueType&& value) override {
+				std::unique_lock<std::mutex> lock(this->_mutex);
+				if (this->_completed)
+					return;
+
+				this->_value.Set(std::move(value));
+				this->_completed = true;
+				this->_cv.notify_all();
+			}
+
+			void SetFailed(std::shared_ptr<std::exception> exception) override {
+				this->SetFailed(exception, nullptr);
+			}
+
+			// Without the original exception only a copy of the shared one's std::exception part can be thrown
+			void SetFailed(std::shared_ptr<std::exception> exception, std::exception_ptr exceptionPtr) override {
+				std::unique_lock<std::mutex> lock(this->_mutex);
+				if (this->_completed)
+					return;
+
+				if (exceptionPtr)
+					this->_exceptionPtr = exceptionPtr;
+				else if (exception)
+					this->_exceptionPtr = std::make_exception_ptr(*exception);
+				else
+					this->_exceptionPtr = std::make_exception_ptr(std::exception("Failed to build object"));
+
+				this->_completed = true;
+				this->_cv.notify_all();
+			}
+
+			TValueType Wait() {
+				std::unique_lock<std::mutex> lock(this->_mutex);
+				while (!this->_completed)
+					this->_cv.wait(lock);
+
+				if (this->_exceptionPtr)
+					std::rethrow_exception(this->_exceptionPtr);
+
+				return std::move(this->_value.Get());
+			}
+		};
+
+	public:
+		using IObjectBuilder<TKeyType, TValueType>::BuildObject;
+
+		// Starts building the object, with the outcome being reported through the completion. Note that the
+		// dependency values are only valid for the duration of this call, so anything which is needed once
+		// the build has gone asynchronous must be copied
+		virtual void BuildObjectAsync(const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies, std::shared_ptr<IAsyncBuildCompletion<TValueType>> completion) = 0;
+
+		// Synchronous equivalent, which blocks the calling thread until the asynchronous build completes
+		TValueType BuildObject(const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) override {
+			auto completion = std::make_shared<blockingCompletion>();
+			this->BuildObjectAsync(address, dependencies, completion);
+			return completion->Wait();
+		}
+	};
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+#include "IObjectBuilder.h"
+
+namespace dependencygraph {
+
+	// Optional extension of IObjectBuilder for builders which can build many objects in a single call.
+	//
+	// When a node's builder implements this interface, the object context will collect together ready
+	// nodes which share the same builder instance and hand them over as a single batch. This allows the
+	// builder to amortise per-call overhead and to vectorise across nodes. The single object BuildObject
+	// method must still be implemented as it is used when a batch fails so that the failure can be
+	// attributed to the correct node.
+	//
+	// Batches copy the dependency values into contiguous arrays and have the results assigned into an array
+	// of values, so the value type must be copyable and default constructible. For any other value type the
+	// nodes are built individually through BuildObject.
+	template <class TKeyType, class TValueType>
+	class IBatchObjectBuilder : public IObjectBuilder<TKeyType, TValueType> {
+	public:
+		// Builds count objects in a single call.
+		//
+		// The dependency values for addresses[i] are stored contiguously in dependencyValues, starting at 
+		// dependencyOffsets[i] and ending (exclusive) at dependencyOffsets[i + 1], in the same order as they were
+		// returned from GetDependencies. results has space for count values.
+		virtual void BuildObjects(size_t count,
+			const TKeyType* addresses,
+			const TValueType* dependencyValues,
+			const size_t* dependencyOffsets,
+			TValueType* results) = 0;
+
+		// The maximum number of objects which should be passed to a single BuildObjects call
+		virtual size_t GetMaxBatchSize() {
+			return 256;
+		}
+	};
+}
@@ -22,13 +22,45 @@ namespace dependencygraph {
 		DependencyGraphJobStyle style;
 		std::function<void()> func;
 
-		DependencyGraphJob() : style(DependencyGraphJobStyle::other) { }
-		DependencyGraphJob(DependencyGraphJobStyle style, std::function<void()>&& func) : style(style), func(func) {};
+		// The worker group which the job would ideally run on (typically that which built most of its
+		// dependencies), or -1 if there's no preference
+		int preferredWorkerGroup;
+
+		DependencyGraphJob() : style(DependencyGraphJobStyle::other), preferredWorkerGroup(-1) { }
+		DependencyGraphJob(DependencyGraphJobStyle style, std::function<void()>&& func) : style(style), func(func), preferredWorkerGroup(-1) {};
 	};
 
 	class IDependencyGraphJobQueue {
 
 	public:
 		virtual void RegisterJob(DependencyGraphJob&& job) = 0;
+
+		// The number of worker groups which jobs can express a preference for, job queues which
+		// don't support locality have just the one
+		virtual int GetWorkerGroupCount() {
+			return 1;
+		}
+
+		// The number of jobs which are waiting to be run, job queues which run their jobs straight away (or
+		// which don't track this) report zero
+		virtual size_t GetQueuedJobCount() {
+			return 0;
+		}
 	};
+
+	// The job queue whose job is running on the calling thread, or nullptr if it isn't running one. This is
+	// set by the job queues around each job so that work can tell whether it may continue inline on the
+	// calling thread rather than being registered with its queue
+	inline IDependencyGraphJobQueue*& currentJobQueueStorage() {
+		static thread_local IDependencyGraphJobQueue* jobQueue = nullptr;
+		return jobQueue;
+	}
+
+	inline IDependencyGraphJobQueue* GetCurrentJobQueue() {
+		return currentJobQueueStorage();
+	}
+
+	inline void SetCurrentJobQueue(IDependencyGraphJobQueue* jobQueue) {
+		currentJobQueueStorage() = jobQueue;
+	}
 }
\ No newline at end of file
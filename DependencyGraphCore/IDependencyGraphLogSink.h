@@ -0,0 +1,64 @@
+#pragma once
+
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace dependencygraph {
+
+	enum class LogLevel {
+		information,
+		warning,
+		error,
+	};
+
+	// Destination for the object context's diagnostics, e.g. nodes which have failed to build. Messages are
+	// only formatted if a sink has been supplied, and only for the node where a failure originates (not the
+	// nodes which fail as a consequence), so logging stays off the hot path
+	class IDependencyGraphLogSink {
+	public:
+		virtual void Log(LogLevel level, const std::wstring& message) = 0;
+	};
+
+	// Log sink which writes to a wide stream, e.g. std::wcout
+	class WideStreamLogSink : public IDependencyGraphLogSink {
+	private:
+		std::wostream& _stream;
+		std::mutex _streamAccessMutex;
+
+	public:
+		WideStreamLogSink(std::wostream& stream = std::wcout) :
+			_stream(stream) {
+		}
+
+		void Log(LogLevel level, const std::wstring& message) override {
+			std::unique_lock<std::mutex> lock(this->_streamAccessMutex);
+			this->_stream << message << std::endl;
+		}
+	};
+
+	// Formats a failure, i.e. the message and address plus the exception's description (if any)
+	template <class TKeyType>
+	std::wstring FormatFailure(const wchar_t* message, const TKeyType& address, const std::exception_ptr& exceptionPtr) {
+		std::wostringstream stream;
+		stream << message << L" #" << address;
+
+		if (exceptionPtr) {
+			try {
+				std::rethrow_exception(exceptionPtr);
+			}
+			catch (const std::exception& e) {
+				stream << L": ";
+				for (auto pChar = e.what(); *pChar; ++pChar)
+					stream << (wchar_t)(unsigned char)*pChar;
+			}
+			catch (...) {
+			}
+		}
+
+		return stream.str();
+	}
+}
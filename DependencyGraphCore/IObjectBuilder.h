@@ -3,12 +3,39 @@
 #include <vector>
 #include <unordered_map>
 
+#include "DependencyValues.h"
+
 namespace dependencygraph {
 
 	template <class TKeyType, class TValueType>
 	class IObjectBuilder {
 	public:
 		virtual std::vector<TKeyType> GetDependencies(const TKeyType& address) = 0;
-		virtual TValueType BuildObject(const TKeyType& address, const std::unordered_map<TKeyType, TValueType>& dependencies) = 0;
+
+		// Builds the object from a copy of the dependency values. Builders should implement either this or
+		// the DependencyValues overload below
+		virtual TValueType BuildObject(const TKeyType& address, const std::unordered_map<TKeyType, TValueType>& dependencies) {
+			throw std::exception("BuildObject not implemented");
+		}
+
+		// Builds the object from the dependency values borrowed from the dependency nodes. This is what the
+		// object context calls, by default it copies the values and calls the map based overload, builders
+		// for large or move-only values should override this instead to avoid the copies
+		virtual TValueType BuildObject(const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) {
+			return this->BuildObject(address, dependencies.ToMap());
+		}
+
+		// Builders which always produce the same value (e.g. overrides) should return true here, in which
+		// case the node is marked as built straight away rather than being scheduled
+		virtual bool IsConstant() {
+			return false;
+		}
+
+		// Builders whose objects depend on the dependency values alone (and not on the address) can return true
+		// here, in which case nodes with the same builder and dependency values can share a single build when
+		// the object context has a build memo (see BuildMemo)
+		virtual bool IsMemoizable() {
+			return false;
+		}
 	};
-}
\ No newline at end of file
+}
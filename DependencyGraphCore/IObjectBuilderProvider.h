@@ -10,5 +10,12 @@ namespace dependencygraph {
 	class IObjectBuilderProvider {
 	public:
 		virtual bool TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) = 0;
+
+		// Looks up just the override of an address (i.e. the constant builder which TryGetObjectBuilder would
+		// return for it), for where the provider is otherwise bypassed (e.g. restoring a persisted topology).
+		// Providers which support overrides should implement this
+		virtual bool TryGetOverrideObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
+			return false;
+		}
 	};
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "IDependencyGraphJobQueue.h"
+#include "ThreadPoolConfiguration.h"
 
 // TODO - This looks odd because IJobQueue isn't currently templatised, but it will be shortly...
 
@@ -18,15 +19,26 @@ namespace dependencygraph {
 		std::mutex _queueAccessMutex;
 		std::condition_variable _queueAccessCV;
 	public:
+		// Jobs without a worker group preference
 		std::queue<DependencyGraphJob> _jobs;
+
+		// Jobs which would prefer to run on a specific worker group, these can still be stolen by other
+		// groups if they would otherwise be idle
+		std::vector<std::queue<DependencyGraphJob>> _workerGroupJobs;
 		std::atomic<int> totalRequests;
 	private:
+		std::atomic<size_t> _queuedJobCount;
 		volatile bool _stopRequested;
 
+		bool tryGetJob(int workerGroupIdx, DependencyGraphJob& job);
+
 	public:
 		MultithreadedJobQueue(int threadCount);
+		MultithreadedJobQueue(const ThreadPoolConfiguration& configuration);
 
 		void RegisterJob(DependencyGraphJob&& job) override;
+		int GetWorkerGroupCount() override;
+		size_t GetQueuedJobCount() override;
 
 		~MultithreadedJobQueue();
 		void StopThreads();
@@ -37,59 +49,108 @@ namespace dependencygraph {
 		this->totalRequests.fetch_add(1);
 
 		std::unique_lock<std::mutex> lock(this->_queueAccessMutex);
-		this->_jobs.push(job);
+		if (this->_workerGroupJobs.size() > 1 && job.preferredWorkerGroup >= 0 && job.preferredWorkerGroup < (int)this->_workerGroupJobs.size())
+			this->_workerGroupJobs[job.preferredWorkerGroup].push(std::move(job));
+		else
+			this->_jobs.push(std::move(job));
 
+		this->_queuedJobCount.fetch_add(1);
 		this->_queueAccessCV.notify_all();
 	}
 
+	int MultithreadedJobQueue::GetWorkerGroupCount() {
+		return (int)this->_workerGroupJobs.size();
+	}
+
+	size_t MultithreadedJobQueue::GetQueuedJobCount() {
+		return this->_queuedJobCount.load();
+	}
+
+	// Must be called with the queue access mutex held
+	bool MultithreadedJobQueue::tryGetJob(int workerGroupIdx, DependencyGraphJob& job) {
+		auto& ownJobs = this->_workerGroupJobs[workerGroupIdx];
+		if (!ownJobs.empty()) {
+			job = std::move(ownJobs.front());
+			ownJobs.pop();
+			this->_queuedJobCount.fetch_sub(1);
+			return true;
+		}
+
+		if (!this->_jobs.empty()) {
+			job = std::move(this->_jobs.front());
+			this->_jobs.pop();
+			this->_queuedJobCount.fetch_sub(1);
+			return true;
+		}
+
+		// Better to run the job remotely than to leave this thread idle
+		for (size_t i = 1; i < this->_workerGroupJobs.size(); ++i) {
+			auto& otherJobs = this->_workerGroupJobs[(workerGroupIdx + i) % this->_workerGroupJobs.size()];
+			if (!otherJobs.empty()) {
+				job = std::move(otherJobs.front());
+				otherJobs.pop();
+				this->_queuedJobCount.fetch_sub(1);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
 	MultithreadedJobQueue::MultithreadedJobQueue(int threadCount) :
+		MultithreadedJobQueue(ThreadPoolConfiguration::FromThreadCount(threadCount)) {
+	}
+
+	MultithreadedJobQueue::MultithreadedJobQueue(const ThreadPoolConfiguration& configuration) :
 		_stopRequested(false),
-		totalRequests(0) {
-		if (threadCount == 0)
+		totalRequests(0),
+		_queuedJobCount(0) {
+		if (configuration.GetTotalThreadCount() <= 0)
 			throw std::exception("Invalid thread count specified");
 
-		if (threadCount < 0) {
-			// TODO - Read this value in from somewhere
-			threadCount = 16;
-		}
+		this->_workerGroupJobs.resize(configuration.workerGroups.size());
 
-		for (int i(0); i < threadCount; ++i) {
-			_threads.push_back(std::thread([this]() -> void {
+		for (int workerGroupIdx(0); workerGroupIdx < (int)configuration.workerGroups.size(); ++workerGroupIdx) {
+			for (int i(0); i < configuration.workerGroups[workerGroupIdx].threadCount; ++i) {
+				_threads.push_back(std::thread([this, configuration, workerGroupIdx, i]() -> void {
 
-				while (true) {
-					try {
-						if (_stopRequested)
-							return;
+					ApplyWorkerPlacement(configuration, workerGroupIdx, i);
+					SetCurrentJobQueue(this);
 
-						std::unique_lock<std::mutex> lock(this->_queueAccessMutex);
-						if (this->_jobs.empty()) {
-							// Nothing to do
+					while (true) {
+						try {
 							if (_stopRequested)
 								return;
 
-							this->_queueAccessCV.wait(lock);
-						}
-						else {
-							auto job = this->_jobs.front();
-							_jobs.pop();
-							lock.unlock();
-
-							try
-							{
-								job.func();
+							std::unique_lock<std::mutex> lock(this->_queueAccessMutex);
+							DependencyGraphJob job;
+							if (!this->tryGetJob(workerGroupIdx, job)) {
+								// Nothing to do
+								if (_stopRequested)
+									return;
+
+								this->_queueAccessCV.wait(lock);
 							}
-							catch (...) {
-								// What to do here?
+							else {
+								lock.unlock();
+
+								try
+								{
+									job.func();
+								}
+								catch (...) {
+									// What to do here?
+								}
 							}
-						}
 
-					}
-					catch (...) {
+						}
+						catch (...) {
 
+						}
 					}
-				}
 
-				}));
+					}));
+			}
 		}
 	}
 
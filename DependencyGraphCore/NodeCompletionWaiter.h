@@ -0,0 +1,36 @@
+#pragma once
+
+#include <mutex>
+
+namespace dependencygraph {
+
+	// Handle through which something outside of the object context completes a node, i.e. a build memo entry
+	// (which may be being built for a node of another context) or an asynchronous build. The node can be reset,
+	// or destroyed along with its context, before that happens, so the node detaches its handle first and the
+	// completion is then skipped
+	class NodeCompletionWaiter {
+	private:
+		// Recursive as the node may be detached from within its own completion (e.g. by a post build call back)
+		std::recursive_mutex _accessMutex;
+		bool _detached;
+
+	public:
+		NodeCompletionWaiter() :
+			_detached(false) {
+		}
+
+		// Calls the func unless the waiter has been detached, holding the lock throughout so that Detach
+		// doesn't return whilst it's still running
+		template <class TFunc>
+		void Run(TFunc&& func) {
+			std::unique_lock<std::recursive_mutex> lock(this->_accessMutex);
+			if (!this->_detached)
+				func();
+		}
+
+		void Detach() {
+			std::unique_lock<std::recursive_mutex> lock(this->_accessMutex);
+			this->_detached = true;
+		}
+	};
+}
@@ -1,35 +1,130 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 
+#include "BuildCostModel.h"
+#include "BuildMemo.h"
+#include "CancellationToken.h"
+#include "IAsyncObjectBuilder.h"
+#include "IBatchObjectBuilder.h"
+#include "IDependencyGraphJobQueue.h"
+#include "IDependencyGraphLogSink.h"
+#include "NodeCompletionWaiter.h"
+#include "ObjectBuilderPolicy.h"
 #include "ObjectBuildingState.h"
+#include "ThreadPoolConfiguration.h"
+#include "ValueStorage.h"
 #include "WaitHandle.h"
 
 namespace dependencygraph {
 
 	// Forward definition
-	template <class TKeyType, class TValueType> class ObjectContext;
+	template <class TKeyType, class TValueType, class TBuilderPolicy = DynamicObjectBuilderPolicy<TKeyType, TValueType>> class ObjectContext;
 
-	// Object representing a node within an object context
-	template <class TKeyType, class TValueType>
+	// The number of nodes currently being failed (nested) on the calling thread as a consequence of a
+	// dependency failing, beyond which the failure continues through the job queue so that a long chain of
+	// dependents doesn't exhaust the stack
+	const int maximumFailureCascadeDepth = 64;
+
+	inline int& currentFailureCascadeDepthStorage() {
+		static thread_local int failureCascadeDepth = 0;
+		return failureCascadeDepth;
+	}
+
+	// A node whose post build call backs are being run by the calling thread, along with its object context
+	struct completingNode {
+		const void* objectBuilderInfo;
+		const void* objectContext;
+	};
+
+	// The nodes whose post build call backs are being run (nested) by the calling thread, so that a context
+	// isn't reset, or left waiting, from within the call backs of its own nodes
+	inline std::vector<completingNode>& currentCompletingNodesStorage() {
+		static thread_local std::vector<completingNode> completingNodes;
+		return completingNodes;
+	}
+
+	// Object representing a node within an object context, TBuilderPolicy being its object context's (see
+	// DynamicObjectBuilderPolicy)
+	template <class TKeyType, class TValueType, class TBuilderPolicy = DynamicObjectBuilderPolicy<TKeyType, TValueType>>
 	class ObjectBuilderInfo {
 
 	private:
+		friend class ObjectContext<TKeyType, TValueType, TBuilderPolicy>;
+
+		std::atomic<bool> _discoveryStarted;
 		std::atomic<int> _buildRequestCount;
 
-		std::vector<std::function<void(ObjectBuilderInfo<TKeyType, TValueType>&)>> _postDependenciesKnownCallBacks;
-		std::vector<std::function<void(ObjectBuilderInfo<TKeyType, TValueType>&)>> _postBuildCallBacks;
+		std::vector<std::function<void(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>&)>> _postDependenciesKnownCallBacks;
+		std::vector<std::function<void(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>&)>> _postBuildCallBacks;
 
 		std::atomic<int> _outstandingDependenciesCount;
 
+		// The set of requests which are interested in this node being built. A request without a
+		// cancellation token can never be abandoned so, once seen, the token list is irrelevant
+		std::mutex _interestMutex;
+		std::atomic<bool> _hasUncancellableInterest;
+		std::vector<std::shared_ptr<CancellationToken>> _interestTokens;
+
+		// Set if the object builder supports building many objects in a single call
+		IBatchObjectBuilder<TKeyType, TValueType>* _batchObjectBuilder;
+
+		// Set if the object builder builds its objects asynchronously
+		IAsyncObjectBuilder<TKeyType, TValueType>* _asyncObjectBuilder;
+
+		class asyncBuildCompletion;
+
+		// The built value, held in place so that the value type needn't be default constructible
+		ValueStorage<TValueType> _builtObject;
+
+		// The measured cost of the node's builder, null for constants
+		std::shared_ptr<BuilderBuildCost> _buildCost;
+
+		// Set whilst the node is counted as in flight by the object context's admission controller
+		std::atomic<bool> _admissionCounted;
+
+		// The first dependency to fail (if any), whose exception the node fails with once the rest of its
+		// dependencies have completed, rather than it being scheduled
+		std::atomic<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> _failedDependency;
+
+		// Non-zero from just before the node reaches a terminal state until its post build call backs have
+		// finished, as anything waiting on the node may carry on (e.g. reset the context) whilst they run
+		std::atomic<int> _completingCount;
+
+		// Handle on the build memo entry or asynchronous build which is to complete the node (if any), detached
+		// when the node is reset or its context destroyed, as neither is tied to the context's lifetime
+		std::shared_ptr<NodeCompletionWaiter> _completionWaiter;
+
+		void setDependenciesKnown();
+		void detachCompletionWaiter();
 		void launchPostDependenciesKnownCallBacks();
 		void launchPostBuildCallBacks();
 
+		bool addInterest(const std::shared_ptr<CancellationToken>& cancellationToken);
+		bool tryRestartCancelled();
+		void scheduleBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue);
+		bool scheduleBatchBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue, std::true_type valueTypeIsBatchable);
+		bool scheduleBatchBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue, std::false_type valueTypeIsBatchable);
+		bool buildObjectMemoized(const DependencyValues<TKeyType, TValueType>& builtDependencies, std::true_type valueTypeIsCopyable);
+		bool buildObjectMemoized(const DependencyValues<TKeyType, TValueType>& builtDependencies, std::false_type valueTypeIsCopyable);
+		int getPreferredWorkerGroup(int workerGroupCount);
+		bool tryFuseBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue);
+		bool isBuildInProgress();
+		void waitForCallBacks();
+		void reset();
+		void dependencyCompleted(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue);
+		void failFromDependency(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue);
+		void logFailure(const wchar_t* message, const std::exception_ptr& exceptionPtr);
+
 		void buildObject();
+		void buildObjectAsync(const DependencyValues<TKeyType, TValueType>& builtDependencies);
 
 		std::atomic<ObjectBuildingState> _state;
 
@@ -38,11 +133,16 @@ namespace dependencygraph {
 			return _state.load();
 		}
 
-		ObjectContext<TKeyType, TValueType>* objectContext;
+		ObjectContext<TKeyType, TValueType, TBuilderPolicy>* objectContext;
 		const TKeyType key;
 		std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder;
 
 		std::vector<TKeyType> dependencies;
+
+		// The nodes for each of the dependencies (in the same order), resolved once during discovery. These
+		// are owned by the object context and so live for as long as this node does
+		std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> dependencyNodes;
+
 		dependencygraph::WaitHandle dependenciesKnownWaitHandle;
 		std::mutex dependenciesKnownMutex;
 		std::condition_variable dependenciesKnownCV;
@@ -51,43 +151,77 @@ namespace dependencygraph {
 		std::mutex objectBuiltOrFailureMutex;
 		std::condition_variable objectBuiltOrFailureCV;
 
-		TValueType builtObject;
 		std::shared_ptr<std::exception> exception;
 
-		ObjectBuilderInfo(ObjectContext<TKeyType, TValueType>* objectContext,
+		// The exception which caused the failure, as originally thrown (for use with std::rethrow_exception). Nodes
+		// which fail because a dependency failed share the dependency's exception(s)
+		std::exception_ptr exceptionPtr;
+
+		// The job queue worker group which built the object, -1 if not built on a worker thread
+		int builtOnWorkerGroup;
+
+		// When the object builder was called, only set for objects which have actually been built
+		std::chrono::steady_clock::time_point buildStartTime;
+		std::chrono::steady_clock::time_point buildEndTime;
+
+		ObjectBuilderInfo(ObjectContext<TKeyType, TValueType, TBuilderPolicy>* objectContext,
 			const TKeyType& key) :
 			objectContext(objectContext),
 			key(key),
+			_discoveryStarted(false),
 			_buildRequestCount(0),
-			builtObject(TValueType()),
+			_hasUncancellableInterest(false),
+			_batchObjectBuilder(nullptr),
+			_asyncObjectBuilder(nullptr),
+			_admissionCounted(false),
+			_failedDependency(nullptr),
+			_completingCount(0),
+			builtOnWorkerGroup(-1),
 			_state(ObjectBuildingState::Starting),
-			objectBuiltOrFailureWaitHandle(&_state, &objectBuiltOrFailureMutex, &objectBuiltOrFailureCV, { ObjectBuildingState::Failure, ObjectBuildingState::NoBuilderAvailable, ObjectBuildingState::ObjectBuilt }),
-			dependenciesKnownWaitHandle(&_state, &dependenciesKnownMutex, &dependenciesKnownCV, { ObjectBuildingState::Failure, ObjectBuildingState::NoBuilderAvailable, ObjectBuildingState::ObjectBuilt, ObjectBuildingState::DependenciesKnown }) {
+			objectBuiltOrFailureWaitHandle(&_state, &objectBuiltOrFailureMutex, &objectBuiltOrFailureCV, { ObjectBuildingState::Failure, ObjectBuildingState::NoBuilderAvailable, ObjectBuildingState::ObjectBuilt, ObjectBuildingState::Cancelled }),
+			dependenciesKnownWaitHandle(&_state, &dependenciesKnownMutex, &dependenciesKnownCV, { ObjectBuildingState::Failure, ObjectBuildingState::NoBuilderAvailable, ObjectBuildingState::ObjectBuilt, ObjectBuildingState::DependenciesKnown, ObjectBuildingState::Cancelled, ObjectBuildingState::Building }) {
 		}
 
 		// Set the object builder to be used (but do nothing with it for now)
 		void SetObjectBuilder(std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
 			this->objectBuilder = objectBuilder;
+			this->_batchObjectBuilder = TBuilderPolicy::GetBatchObjectBuilder(*objectBuilder);
+			this->_asyncObjectBuilder = TBuilderPolicy::GetAsyncObjectBuilder(*objectBuilder);
 		}
 
-		void SetRequestedDependencies(std::vector<TKeyType>&& dependencies) {
-			this->dependencies = std::move(dependencies);
-			this->_state = ObjectBuildingState::DependenciesKnown;
-			{
-				std::unique_lock<std::mutex> accessor(this->dependenciesKnownMutex);
-				this->dependenciesKnownCV.notify_all();
-			}
+		// The dependencies are assigned into the node's existing vectors, rather than the node taking over the
+		// supplied ones, so that a node which is reused after a Reset keeps the capacity it already has
+		void SetRequestedDependencies(std::vector<TKeyType>&& dependencies, std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*>&& dependencyNodes) {
+			this->dependencies.clear();
+			this->dependencies.insert(this->dependencies.end(), std::make_move_iterator(dependencies.begin()), std::make_move_iterator(dependencies.end()));
+			this->dependencyNodes.assign(dependencyNodes.begin(), dependencyNodes.end());
+			this->setDependenciesKnown();
+		}
 
-			this->launchPostDependenciesKnownCallBacks();
+		void SetRequestedDependencies(std::vector<TKeyType>& dependencies, std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*>& dependencyNodes) {
+			this->dependencies.assign(dependencies.begin(), dependencies.end());
+			this->dependencyNodes.assign(dependencyNodes.begin(), dependencyNodes.end());
+			this->setDependenciesKnown();
+		}
+
+		// Returns the built value (borrowed, so valid for as long as the object context), only valid
+		// once the state is ObjectBuilt
+		const TValueType& GetBuiltObject() const {
+			if (!this->_builtObject.HasValue())
+				throw std::exception("Object has not been built");
+
+			return this->_builtObject.Get();
 		}
 
-		void SetRequestedDependencies(std::vector<TKeyType>& dependencies) {
-			auto localCopy = dependencies;
-			this->SetRequestedDependencies(std::move(localCopy));
+		void SetObjectBuilt(const TValueType& builtObject) {
+			TValueType localCopy(builtObject);
+			this->SetObjectBuilt(std::move(localCopy));
 		}
 
-		void SetObjectBuilt(TValueType& builtObject) {
-			this->builtObject = builtObject;
+		void SetObjectBuilt(TValueType&& builtObject) {
+			this->_builtObject.Set(std::move(builtObject));
+			this->builtOnWorkerGroup = GetCurrentWorkerGroup();
+			this->_completingCount.fetch_add(1);
 			this->_state = ObjectBuildingState::ObjectBuilt;
 
 			{
@@ -99,7 +233,13 @@ namespace dependencygraph {
 		}
 
 		void SetObjectFailed(std::shared_ptr<std::exception>& exception) {
+			this->SetObjectFailed(exception, nullptr);
+		}
+
+		void SetObjectFailed(std::shared_ptr<std::exception>& exception, std::exception_ptr exceptionPtr) {
 			this->exception = exception;
+			this->exceptionPtr = exceptionPtr;
+			this->_completingCount.fetch_add(1);
 			this->_state = ObjectBuildingState::Failure;
 
 			{
@@ -115,7 +255,27 @@ namespace dependencygraph {
 			this->launchPostBuildCallBacks();
 		}
 
+		// Marks the node as built with a value which was known up front, i.e. without either dependencies
+		// or going via the job queue
+		void SetObjectOverridden(TValueType&& builtObject) {
+			this->_builtObject.Set(std::move(builtObject));
+			this->_completingCount.fetch_add(1);
+			this->_state = ObjectBuildingState::ObjectBuilt;
+			{
+				std::unique_lock<std::mutex> accessor(this->dependenciesKnownMutex);
+				this->dependenciesKnownCV.notify_all();
+			}
+			{
+				std::unique_lock<std::mutex> accessor(this->objectBuiltOrFailureMutex);
+				this->objectBuiltOrFailureCV.notify_all();
+			}
+
+			this->launchPostDependenciesKnownCallBacks();
+			this->launchPostBuildCallBacks();
+		}
+
 		void SetNoBuilderFound() {
+			this->_completingCount.fetch_add(1);
 			this->_state = ObjectBuildingState::NoBuilderAvailable;
 			{
 				std::unique_lock<std::mutex> accessor(this->dependenciesKnownMutex);
@@ -130,112 +290,706 @@ namespace dependencygraph {
 			this->launchPostBuildCallBacks();
 		}
 
-		void RegisterPostDependenciesKnownCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType>&)>&& callBackFunc);
-		void RegisterPostBuildCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType>&)>&& callBackFunc);
+		// Marks the node as abandoned, all requests which were interested in it having been cancelled. Note
+		// that unlike the other terminal states, a subsequent live request will restart the build
+		void SetObjectCancelled() {
+			{
+				std::unique_lock<std::mutex> accessor(this->objectBuiltOrFailureMutex);
+				auto expected = ObjectBuildingState::DependenciesKnown;
+				this->_completingCount.fetch_add(1);
+				if (!this->_state.compare_exchange_strong(expected, ObjectBuildingState::Cancelled)) {
+					this->_completingCount.fetch_sub(1);
+					return;
+				}
+
+				this->objectBuiltOrFailureCV.notify_all();
+			}
+
+			this->launchPostBuildCallBacks();
+		}
+
+		// Returns true if every request which has asked for this node to be built has since been cancelled
+		bool IsCancellationRequested() {
+			if (this->_hasUncancellableInterest.load())
+				return false;
+
+			std::unique_lock<std::mutex> lock(this->_interestMutex);
+			if (this->_hasUncancellableInterest.load())
+				return false;
+
+			for (auto& token : this->_interestTokens) {
+				if (!token->IsCancellationRequested())
+					return false;
+			}
+
+			return !this->_interestTokens.empty();
+		}
+
+		void RegisterPostDependenciesKnownCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>&)>&& callBackFunc);
+		void RegisterPostBuildCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>&)>&& callBackFunc);
+
+		// Builds a set of ready objects which share the same batch object builder through a single call
+		static void BuildObjects(std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*>& objectBuilderInfos, IBatchObjectBuilder<TKeyType, TValueType>* batchObjectBuilder);
+
+		void RequestBuildObject(std::shared_ptr<IDependencyGraphJobQueue> jobQueue, std::shared_ptr<CancellationToken> cancellationToken = nullptr) {
+			bool interestChanged = this->addInterest(cancellationToken);
+
+			// A previously abandoned node needs to be built again if this request is still live
+			if (this->getState() == ObjectBuildingState::Cancelled && !this->IsCancellationRequested())
+				this->tryRestartCancelled();
 
-		void RequestBuildObject(std::shared_ptr<IDependencyGraphJobQueue> jobQueue) {
 			auto originalValue = _buildRequestCount.exchange(1);
-			if (originalValue == 0) {
-				// This was the actual build....
+			if (originalValue != 0) {
+				// Somebody else has already requested the build, but our request may still need to be
+				// registered against the dependencies so that they are not abandoned underneath us
+				if (interestChanged) {
+					this->RegisterPostDependenciesKnownCallBack([jobQueue, cancellationToken](ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>& address) mutable {
+						if (address.getState() != ObjectBuildingState::DependenciesKnown)
+							return;
 
-				switch (this->getState()) {
-				case ObjectBuildingState::Failure:
-				case ObjectBuildingState::NoBuilderAvailable:
-					return;
+						for (auto dependencyOBI : address.dependencyNodes)
+							address.objectContext->requestBuildObjectInt(dependencyOBI, jobQueue, cancellationToken);
+						});
 				}
+				return;
+			}
 
-				this->RegisterPostDependenciesKnownCallBack([this, jobQueue](ObjectBuilderInfo<TKeyType, TValueType>& address) {
-					// This method will be called once we know all of the dependencies that this
-					// particular object will depend upon
-
-					// TODO 
-					// At this point, there are a few possibilities:
-					//  1. We're clearly responsible for building the object
-					//  2. That the object should simply be brought forward
-					//  3. That the object should be built for us, after we've checked that the dependencies have been rebuilt
-					//
-					// The annoyance factor is that it's actually quite hard to work out whether we're in #2 or #3 right now,
-					// with the one special case being when there are explicitly no dependencies to bring forwards
-					try
-					{
-						_outstandingDependenciesCount.store((int)address.dependencies.size());
-
-						// We can request actual building immediately and cannot actually be triggered from a post build call back anyway...
-						if (address.dependencies.size() == 0) {
-							DependencyGraphJob job(DependencyGraphJobStyle::objectBuilding, std::bind(&ObjectBuilderInfo<TKeyType, TValueType>::buildObject, this));
-							jobQueue->RegisterJob(std::move(job));
-						}
-						else {
-							for (auto& dependency : address.dependencies) {
-								auto dependencyOBI = this->objectContext->BuildObject(dependency);
-
-								dependencyOBI->RegisterPostBuildCallBack([this, jobQueue](ObjectBuilderInfo<TKeyType, TValueType>& builtDependency) {
-									int previousCount = _outstandingDependenciesCount.fetch_sub(1);
-									if (previousCount > 1)
-										return;
-
-									// At this point, we know that we need to actually build the object....
-									DependencyGraphJob job(DependencyGraphJobStyle::objectBuilding, std::bind(&ObjectBuilderInfo<TKeyType, TValueType>::buildObject, this));
-									jobQueue->RegisterJob(std::move(job));
-									});
+			// This was the actual build....
+			switch (this->getState()) {
+			case ObjectBuildingState::Failure:
+			case ObjectBuildingState::NoBuilderAvailable:
+				return;
+
+			case ObjectBuildingState::DependenciesKnown:
+				if (this->objectContext->_admissionController.IsEnabled() && !this->_admissionCounted.exchange(true))
+					this->objectContext->_admissionController.NodeStarted();
+				break;
+
+			default:
+				break;
+			}
+
+			this->RegisterPostDependenciesKnownCallBack([this, jobQueue, cancellationToken](ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>& address) mutable {
+				// This method will be called once we know all of the dependencies that this
+				// particular object will depend upon
+
+				// TODO 
+				// At this point, there are a few possibilities:
+				//  1. We're clearly responsible for building the object
+				//  2. That the object should simply be brought forward
+				//  3. That the object should be built for us, after we've checked that the dependencies have been rebuilt
+				//
+				// The annoyance factor is that it's actually quite hard to work out whether we're in #2 or #3 right now,
+				// with the one special case being when there are explicitly no dependencies to bring forwards
+				if (address.getState() != ObjectBuildingState::DependenciesKnown)
+					return;
+
+				try
+				{
+					// Don't bother going any further if nobody wants the result anymore
+					if (this->IsCancellationRequested()) {
+						this->SetObjectCancelled();
+						return;
+					}
+
+					_outstandingDependenciesCount.store((int)address.dependencies.size());
+
+					// We can request actual building immediately and cannot actually be triggered from a post build call back anyway...
+					if (address.dependencies.size() == 0) {
+						this->scheduleBuild(jobQueue);
+					}
+					else {
+						for (auto dependencyOBI : address.dependencyNodes) {
+							// Once a dependency has failed, there's no point requesting the rest
+							if (this->_failedDependency.load()) {
+								this->dependencyCompleted(jobQueue);
+								continue;
 							}
+
+							this->objectContext->requestBuildObjectInt(dependencyOBI, jobQueue, cancellationToken);
+
+							dependencyOBI->RegisterPostBuildCallBack([this, jobQueue](ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>& builtDependency) mutable {
+								switch (builtDependency.getState()) {
+								case ObjectBuildingState::Failure:
+								case ObjectBuildingState::NoBuilderAvailable: {
+									ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* expected(nullptr);
+									this->_failedDependency.compare_exchange_strong(expected, &builtDependency);
+									break;
+								}
+
+								default:
+									break;
+								}
+
+								this->dependencyCompleted(jobQueue);
+								});
 						}
 					}
-					catch (...) {
-						std::wcout << L"Random failure(" << address.key << L")" << std::endl;
+				}
+				catch (...) {
+					auto exceptionPtr = std::current_exception();
+					this->logFailure(L"Failed to schedule object", exceptionPtr);
 
-						auto exception = std::make_shared<std::exception>("Failed");
-						this->SetObjectFailed(exception);
-					}
-					});
+					auto exception = std::make_shared<std::exception>("Failed");
+					this->SetObjectFailed(exception, exceptionPtr);
+				}
+				});
+		}
+	};
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::addInterest(const std::shared_ptr<CancellationToken>& cancellationToken) {
+		if (this->_hasUncancellableInterest.load())
+			return false;
+
+		std::unique_lock<std::mutex> lock(this->_interestMutex);
+		if (!cancellationToken) {
+			auto previousValue = this->_hasUncancellableInterest.exchange(true);
+			this->_interestTokens.clear();
+			return !previousValue;
+		}
 
+		for (auto& token : this->_interestTokens) {
+			if (token == cancellationToken)
+				return false;
+		}
+
+		this->_interestTokens.push_back(cancellationToken);
+		return true;
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::tryRestartCancelled() {
+		std::unique_lock<std::mutex> accessor(this->objectBuiltOrFailureMutex);
+		auto expected = ObjectBuildingState::Cancelled;
+		if (!this->_state.compare_exchange_strong(expected, ObjectBuildingState::DependenciesKnown))
+			return false;
+
+		// Re-arm so that the next request will go through the full scheduling process again
+		this->_buildRequestCount.store(0);
+		this->_failedDependency.store(nullptr);
+		return true;
+	}
+
+	// Returns true if a build has been requested and the node hasn't reached a terminal state yet
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::isBuildInProgress() {
+		switch (this->getState()) {
+		case ObjectBuildingState::Starting:
+		case ObjectBuildingState::DependenciesKnown:
+			return this->_buildRequestCount.load() != 0;
+
+		case ObjectBuildingState::Building:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// Waits for the thread which completed the node to finish running its post build call backs. If the calling
+	// thread is itself running them (e.g. the context is being destroyed by a coroutine which was resumed inline
+	// from one of them) then they can't be waited for, and so they're excluded
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::waitForCallBacks() {
+		int ownCompletingCount(0);
+		for (auto& completingNode : currentCompletingNodesStorage()) {
+			if (completingNode.objectBuilderInfo == this)
+				ownCompletingCount++;
+		}
+
+		while (this->_completingCount.load() > ownCompletingCount)
+			std::this_thread::yield();
+	}
+
+	// Returns the node to its initial state for reuse by ObjectContext::Reset, clearing rather than releasing
+	// the vectors so that their capacity is kept for the next run
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::reset() {
+		this->detachCompletionWaiter();
+		this->waitForCallBacks();
+
+		this->_discoveryStarted.store(false);
+		this->_buildRequestCount.store(0);
+		this->_outstandingDependenciesCount.store(0);
+		this->_postDependenciesKnownCallBacks.clear();
+		this->_postBuildCallBacks.clear();
+		{
+			std::unique_lock<std::mutex> lock(this->_interestMutex);
+			this->_hasUncancellableInterest.store(false);
+			this->_interestTokens.clear();
+		}
+
+		this->_batchObjectBuilder = nullptr;
+		this->_asyncObjectBuilder = nullptr;
+		this->_builtObject.Reset();
+		this->_buildCost = nullptr;
+		this->_admissionCounted.store(false);
+		this->_failedDependency.store(nullptr);
+
+		this->objectBuilder = nullptr;
+		this->dependencies.clear();
+		this->dependencyNodes.clear();
+		this->exception = nullptr;
+		this->exceptionPtr = nullptr;
+		this->builtOnWorkerGroup = -1;
+		this->buildStartTime = std::chrono::steady_clock::time_point();
+		this->buildEndTime = std::chrono::steady_clock::time_point();
+
+		this->_state = ObjectBuildingState::Starting;
+	}
+
+	// Called as each dependency completes (or is skipped), the last one either failing or scheduling the node.
+	// The node only completes once all of the dependencies which were requested have, so that anything waiting
+	// on it can rely on its whole subgraph having finished
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::dependencyCompleted(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue) {
+		int previousCount = _outstandingDependenciesCount.fetch_sub(1);
+		if (previousCount > 1)
+			return;
+
+		// Abandoned nodes are reported as cancelled rather than failed, which is left to scheduleBuild
+		if (this->_failedDependency.load() && !this->IsCancellationRequested()) {
+			this->failFromDependency(jobQueue);
+			return;
+		}
+
+		// At this point, we know that we need to actually build the object....
+		this->scheduleBuild(jobQueue);
+	}
+
+	// Fails the node because one of its dependencies has failed, sharing the dependency's exception, rather than
+	// it being scheduled just to find that it can't be built. This runs within the last dependency's post build
+	// call backs, and so continues straight through to the node's own dependents, without any jobs being
+	// scheduled (up to a maximum depth)
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::failFromDependency(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue) {
+		auto& failedDependency = *this->_failedDependency.load();
+		auto exception = failedDependency.exception;
+		auto exceptionPtr = failedDependency.exceptionPtr;
+		if (!exception) {
+			static auto noBuilderException = std::make_shared<std::exception>("No builder available for dependency");
+			exception = noBuilderException;
+		}
+
+		auto& failureCascadeDepth = currentFailureCascadeDepthStorage();
+		if (failureCascadeDepth >= maximumFailureCascadeDepth) {
+			jobQueue->RegisterJob(DependencyGraphJob(DependencyGraphJobStyle::other, [this, exception, exceptionPtr]() mutable {
+				this->SetObjectFailed(exception, exceptionPtr);
+				}));
+			return;
+		}
+
+		failureCascadeDepth++;
+		this->SetObjectFailed(exception, exceptionPtr);
+		failureCascadeDepth--;
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::logFailure(const wchar_t* message, const std::exception_ptr& exceptionPtr) {
+		auto& logSink = this->objectContext->_logSink;
+		if (logSink)
+			logSink->Log(LogLevel::error, FormatFailure(message, this->key, exceptionPtr));
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::scheduleBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue) {
+		if (this->IsCancellationRequested()) {
+			this->SetObjectCancelled();
+			return;
+		}
+
+		if (this->_batchObjectBuilder && this->scheduleBatchBuild(jobQueue, std::integral_constant<bool, std::is_copy_constructible<TValueType>::value && std::is_default_constructible<TValueType>::value>()))
+			return;
+
+		if (this->tryFuseBuild(jobQueue))
+			return;
+
+		// Only jobs registered with an empty queue measure the dispatch cost, otherwise the delay would include
+		// the time spent waiting behind other jobs
+		auto buildCostModel = this->objectContext->_buildCostModel.get();
+		if (buildCostModel && jobQueue->GetQueuedJobCount() != 0)
+			buildCostModel = nullptr;
+
+		auto registeredTime = buildCostModel ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+		DependencyGraphJob job(DependencyGraphJobStyle::objectBuilding, [this, buildCostModel, registeredTime]() {
+			if (buildCostModel)
+				buildCostModel->RecordSchedulingDelay(std::chrono::steady_clock::now() - registeredTime);
+
+			this->buildObject();
+			});
+
+		auto workerGroupCount = jobQueue->GetWorkerGroupCount();
+		if (workerGroupCount > 1)
+			job.preferredWorkerGroup = this->getPreferredWorkerGroup(workerGroupCount);
+
+		jobQueue->RegisterJob(std::move(job));
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::scheduleBatchBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue, std::true_type valueTypeIsBatchable) {
+		this->objectContext->registerReadyBatchObject(this, this->_batchObjectBuilder, jobQueue);
+		return true;
+	}
+
+	// Batches pass the dependency values as contiguous (copied) arrays and have the results written into an
+	// array of values, which isn't possible for move-only types or those without a default constructor, so
+	// these are built individually
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::scheduleBatchBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue, std::false_type valueTypeIsBatchable) {
+		return false;
+	}
+
+	// Returns the worker group which built the most dependencies, so that the object can be built close to
+	// where its inputs are (in cache / NUMA terms)
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	int ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::getPreferredWorkerGroup(int workerGroupCount) {
+		if (this->dependencies.empty())
+			return -1;
+
+		std::vector<int> votes(workerGroupCount, 0);
+		for (auto dependencyOBI : this->dependencyNodes) {
+			auto workerGroup = dependencyOBI->builtOnWorkerGroup;
+			if (workerGroup >= 0 && workerGroup < workerGroupCount)
+				votes[workerGroup]++;
+		}
+
+		int preferredWorkerGroup(-1), maxVotes(0);
+		for (int i = 0; i < workerGroupCount; ++i) {
+			if (votes[i] > maxVotes) {
+				maxVotes = votes[i];
+				preferredWorkerGroup = i;
 			}
 		}
-	};
 
-	template <class TKeyType, class TValueType>
-	void ObjectBuilderInfo<TKeyType, TValueType>::buildObject() {
+		return preferredWorkerGroup;
+	}
+
+	// Builds the object straight away on the current worker thread if it's cheaper to do so than to schedule it.
+	// This is only done within jobs of the queue which the object would otherwise have been scheduled on, so that
+	// it isn't built on another queue's threads (or a client thread)
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::tryFuseBuild(std::shared_ptr<IDependencyGraphJobQueue>& jobQueue) {
+		auto buildCostModel = this->objectContext->_buildCostModel.get();
+		if (!buildCostModel || !this->_buildCost || !this->objectContext->IsFusionEnabled() || GetCurrentJobQueue() != jobQueue.get() || currentFusionSuppressedStorage())
+			return false;
+
+		auto& fusionDepth = currentFusionDepthStorage();
+		if (fusionDepth >= buildCostModel->maximumFusionDepth || !buildCostModel->ShouldFuse(*this->_buildCost))
+			return false;
+
+		fusionDepth++;
+		this->buildObject();
+		fusionDepth--;
+		return true;
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::buildObject() {
+
+		// The job may have sat in the queue for a while, so check whether it's still wanted
+		if (this->IsCancellationRequested()) {
+			this->SetObjectCancelled();
+			return;
+		}
 
 		try
 		{
-			std::unordered_map<TKeyType, TValueType> builtDependencies;
+			std::vector<const TValueType*> dependencyValues;
+			dependencyValues.reserve(this->dependencyNodes.size());
 			int failureCount(0);
-			for (auto& dependency : this->dependencies) {
-				auto dependencyOBI = this->objectContext->BuildObject(dependency);
+			int cancelledCount(0);
+			for (size_t i = 0; i < this->dependencyNodes.size(); ++i) {
+				auto dependencyOBI = this->dependencyNodes[i];
 				if (dependencyOBI->getState() != ObjectBuildingState::ObjectBuilt) {
-					failureCount++;
+					if (dependencyOBI->getState() == ObjectBuildingState::Cancelled)
+						cancelledCount++;
+					else
+						failureCount++;
 					break;
 				}
 
-				builtDependencies[dependency] = dependencyOBI->builtObject;
+				dependencyValues.push_back(&dependencyOBI->_builtObject.Get());
 			}
 
-			if (failureCount > 0) {
-				std::wcout << L"Failed to source built dependencies for #" << this->key << std::endl;
+			if (cancelledCount > 0) {
+				// A dependency can only have been abandoned if all of its requests were cancelled, which
+				// would normally include ours. If a live request raced in after the dependency was
+				// abandoned, then we have to report failure rather than build with missing inputs
+				if (this->IsCancellationRequested()) {
+					this->SetObjectCancelled();
+					return;
+				}
+
+				failureCount += cancelledCount;
+			}
 
+			if (failureCount > 0) {
 				auto exception = std::make_shared<std::exception>("Failed to source dependency");
 				this->SetObjectFailed(exception);
 				return;
 			}
 
-			auto builtObject = this->objectBuilder->BuildObject(this->key, builtDependencies);
-			this->SetObjectBuilt(builtObject);
+			DependencyValues<TKeyType, TValueType> builtDependencies(this->dependencies.data(), dependencyValues.data(), dependencyValues.size());
+			this->buildStartTime = std::chrono::steady_clock::now();
+
+			if (this->_asyncObjectBuilder) {
+				this->buildObjectAsync(builtDependencies);
+				return;
+			}
+
+			if (this->buildObjectMemoized(builtDependencies, std::integral_constant<bool, std::is_copy_constructible<TValueType>::value>()))
+				return;
+
+			auto builtObject = TBuilderPolicy::BuildObject(*this->objectBuilder, this->key, builtDependencies);
+			this->buildEndTime = std::chrono::steady_clock::now();
+
+			if (this->_buildCost)
+				this->_buildCost->RecordBuild(this->buildEndTime - this->buildStartTime);
+
+			this->SetObjectBuilt(std::move(builtObject));
+		}
+		catch (...)
+		{
+			auto exceptionPtr = std::current_exception();
+			this->logFailure(L"Failed to build object", exceptionPtr);
+
+			auto exception = std::make_shared<std::exception>("Failed to build object dependency");
+			this->SetObjectFailed(exception, exceptionPtr);
+		}
+	}
+
+	// Builds the object through the object context's build memo, so that nodes with the same (memoizable) builder
+	// and dependency values share a single build. Returns false if there's no memo or the builder can't be memoized
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::buildObjectMemoized(const DependencyValues<TKeyType, TValueType>& builtDependencies, std::true_type valueTypeIsCopyable) {
+		// Held locally, as completing the node may let go of the context (and so the memo and entry)
+		auto buildMemo = this->objectContext->_buildMemo;
+		if (!buildMemo || !this->objectBuilder->IsMemoizable())
+			return false;
+
+		auto completionWaiter = std::make_shared<NodeCompletionWaiter>();
+		this->_completionWaiter = completionWaiter;
+
+		auto entry = buildMemo->Acquire(this->objectBuilder, builtDependencies, [this, completionWaiter](const BuildMemoEntry<TKeyType, TValueType>& completedEntry) {
+			completionWaiter->Run([this, &completedEntry]() {
+				this->buildEndTime = std::chrono::steady_clock::now();
+				if (completedEntry.IsSucceeded()) {
+					this->SetObjectBuilt(completedEntry.GetValue());
+				}
+				else {
+					auto exception = completedEntry.exception;
+					this->SetObjectFailed(exception, completedEntry.exceptionPtr);
+				}
+				});
+			});
+
+		// Already built, or being built, for another node
+		if (!entry)
+			return true;
+
+		// The node is completed before the nodes which were waiting on the same build
+		try
+		{
+			auto builtObject = TBuilderPolicy::BuildObject(*this->objectBuilder, this->key, builtDependencies);
+			this->buildEndTime = std::chrono::steady_clock::now();
+
+			if (this->_buildCost)
+				this->_buildCost->RecordBuild(this->buildEndTime - this->buildStartTime);
+
+			buildMemo->SetValue(entry, builtObject);
+			this->SetObjectBuilt(std::move(builtObject));
 		}
 		catch (...)
 		{
-			std::wcout << L"Failed to build object #" << this->key << std::endl;
+			auto exceptionPtr = std::current_exception();
+			this->logFailure(L"Failed to build object", exceptionPtr);
+
 			auto exception = std::make_shared<std::exception>("Failed to build object dependency");
-			this->SetObjectFailed(exception);
+			buildMemo->SetFailed(entry, exception, exceptionPtr);
+			this->SetObjectFailed(exception, exceptionPtr);
+		}
+
+		buildMemo->Complete(entry);
+		return true;
+	}
+
+	// Stops the node being completed by the build memo entry or asynchronous build it's waiting on
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::detachCompletionWaiter() {
+		if (this->_completionWaiter) {
+			this->_completionWaiter->Detach();
+			this->_completionWaiter = nullptr;
+		}
+	}
+
+	// Memoized builds are copied between nodes, which isn't possible for move-only types
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	bool ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::buildObjectMemoized(const DependencyValues<TKeyType, TValueType>& builtDependencies, std::false_type valueTypeIsCopyable) {
+		return false;
+	}
+
+	// Completes a node which is being built asynchronously. The builder may hold on to the completion after the
+	// node has been destroyed along with its context, in which case the node will have detached the waiter and
+	// the outcome is ignored
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	class ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::asyncBuildCompletion : public IAsyncBuildCompletion<TValueType> {
+	private:
+		ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* _objectBuilderInfo;
+		std::shared_ptr<NodeCompletionWaiter> _completionWaiter;
+		std::atomic<bool> _completed;
+
+	public:
+		asyncBuildCompletion(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* objectBuilderInfo, std::shared_ptr<NodeCompletionWaiter> completionWaiter) :
+			_objectBuilderInfo(objectBuilderInfo),
+			_completionWaiter(completionWaiter),
+			_completed(false) {
 		}
+
+		~asyncBuildCompletion() {
+			// The builder has let go of the completion without reporting anything
+			if (!this->_completed.exchange(true)) {
+				this->_completionWaiter->Run([this]() {
+					auto exception = std::make_shared<std::exception>("Asynchronous build abandoned");
+					this->_objectBuilderInfo->SetObjectFailed(exception);
+					});
+			}
+		}
+
+		void SetResult(TValueType&& value) override {
+			if (this->_completed.exchange(true))
+				return;
+
+			this->_completionWaiter->Run([this, &value]() {
+				this->_objectBuilderInfo->buildEndTime = std::chrono::steady_clock::now();
+				this->_objectBuilderInfo->SetObjectBuilt(std::move(value));
+				});
+		}
+
+		void SetFailed(std::shared_ptr<std::exception> exception) override {
+			this->SetFailed(exception, nullptr);
+		}
+
+		void SetFailed(std::shared_ptr<std::exception> exception, std::exception_ptr exceptionPtr) override {
+			if (this->_completed.exchange(true))
+				return;
+
+			this->_completionWaiter->Run([this, &exception, &exceptionPtr]() {
+				this->_objectBuilderInfo->logFailure(L"Failed to build object", exceptionPtr);
+				if (!exception)
+					exception = std::make_shared<std::exception>("Failed to build object dependency");
+
+				this->_objectBuilderInfo->SetObjectFailed(exception, exceptionPtr);
+				});
+		}
+	};
+
+	// Starts the build and returns straight away, the node being completed (and its dependents scheduled) from
+	// whichever thread calls the completion. The completion may have been called (and the node reset or
+	// destroyed along with its context) by the time BuildObjectAsync returns, so the node isn't touched after it
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::buildObjectAsync(const DependencyValues<TKeyType, TValueType>& builtDependencies) {
+		this->_state = ObjectBuildingState::Building;
+
+		auto buildCost = this->_buildCost;
+		auto buildStartTime = this->buildStartTime;
+		auto completionWaiter = std::make_shared<NodeCompletionWaiter>();
+		this->_completionWaiter = completionWaiter;
+
+		auto completion = std::make_shared<asyncBuildCompletion>(this, completionWaiter);
+		try
+		{
+			this->_asyncObjectBuilder->BuildObjectAsync(this->key, builtDependencies, completion);
+		}
+		catch (...)
+		{
+			completion->SetFailed(nullptr, std::current_exception());
+			return;
+		}
+
+		// Only the time taken to start the build counts towards the builder's cost (for fusion purposes)
+		if (buildCost)
+			buildCost->RecordBuild(std::chrono::steady_clock::now() - buildStartTime);
 	}
 
-	template <class TKeyType, class TValueType>
-	void ObjectBuilderInfo<TKeyType, TValueType>::RegisterPostDependenciesKnownCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType>&)>&& callBackFunc) {
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::BuildObjects(std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*>& objectBuilderInfos, IBatchObjectBuilder<TKeyType, TValueType>* batchObjectBuilder) {
+		std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> batch;
+		std::vector<TKeyType> addresses;
+		std::vector<TValueType> dependencyValues;
+		std::vector<size_t> dependencyOffsets;
+
+		batch.reserve(objectBuilderInfos.size());
+		addresses.reserve(objectBuilderInfos.size());
+		dependencyOffsets.reserve(objectBuilderInfos.size() + 1);
+		dependencyOffsets.push_back(0);
+
+		for (auto pOBI : objectBuilderInfos) {
+			if (pOBI->IsCancellationRequested()) {
+				pOBI->SetObjectCancelled();
+				continue;
+			}
+
+			auto startOffset = dependencyValues.size();
+			bool allDependenciesBuilt(true);
+			for (auto dependencyOBI : pOBI->dependencyNodes) {
+				if (dependencyOBI->getState() != ObjectBuildingState::ObjectBuilt) {
+					allDependenciesBuilt = false;
+					break;
+				}
+
+				dependencyValues.push_back(dependencyOBI->_builtObject.Get());
+			}
+
+			if (!allDependenciesBuilt) {
+				// Let the standard path report the failure
+				dependencyValues.erase(dependencyValues.begin() + startOffset, dependencyValues.end());
+				pOBI->buildObject();
+				continue;
+			}
+
+			batch.push_back(pOBI);
+			addresses.push_back(pOBI->key);
+			dependencyOffsets.push_back(dependencyValues.size());
+		}
+
+		if (batch.empty())
+			return;
+
+		std::vector<TValueType> results(batch.size());
+		auto batchStartTime = std::chrono::steady_clock::now();
+		try
+		{
+			batchObjectBuilder->BuildObjects(batch.size(), addresses.data(), dependencyValues.data(), dependencyOffsets.data(), results.data());
+		}
+		catch (...)
+		{
+			// Fall back to building the objects individually so that the failure is attributed to the correct node(s)
+			for (auto pOBI : batch)
+				pOBI->buildObject();
+			return;
+		}
+
+		// Each node is given an equal slice of the batch's build time, so that the work recorded against the nodes
+		// (e.g. by the parallelism analysis) adds up to the batch's rather than counting it once per node
+		auto batchDuration = std::chrono::steady_clock::now() - batchStartTime;
+		auto batchSize = (long long)batch.size();
+		for (size_t i = 0; i < batch.size(); ++i) {
+			batch[i]->buildStartTime = batchStartTime + batchDuration * (long long)i / batchSize;
+			batch[i]->buildEndTime = batchStartTime + batchDuration * (long long)(i + 1) / batchSize;
+			batch[i]->SetObjectBuilt(std::move(results[i]));
+		}
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::RegisterPostDependenciesKnownCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>&)>&& callBackFunc) {
 		switch (this->getState()) {
 		case ObjectBuildingState::DependenciesKnown:
 		case ObjectBuildingState::Failure:
 		case ObjectBuildingState::NoBuilderAvailable:
 		case ObjectBuildingState::ObjectBuilt:
+		case ObjectBuildingState::Cancelled:
+		case ObjectBuildingState::Building:
 			// Can run immediately...
 			if (callBackFunc)
 				callBackFunc(*this);
@@ -248,6 +1002,8 @@ namespace dependencygraph {
 			case ObjectBuildingState::Failure:
 			case ObjectBuildingState::NoBuilderAvailable:
 			case ObjectBuildingState::ObjectBuilt:
+			case ObjectBuildingState::Cancelled:
+			case ObjectBuildingState::Building:
 				// Can run immediately...
 				lock.unlock();
 				if (callBackFunc)
@@ -264,12 +1020,13 @@ namespace dependencygraph {
 		}
 	}
 
-	template <class TKeyType, class TValueType>
-	void ObjectBuilderInfo<TKeyType, TValueType>::RegisterPostBuildCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType>&)>&& callBackFunc) {
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::RegisterPostBuildCallBack(std::function<void(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>&)>&& callBackFunc) {
 		switch (this->getState()) {
 		case ObjectBuildingState::Failure:
 		case ObjectBuildingState::NoBuilderAvailable:
 		case ObjectBuildingState::ObjectBuilt:
+		case ObjectBuildingState::Cancelled:
 			// Can run immediately...
 			if (callBackFunc)
 				callBackFunc(*this);
@@ -284,6 +1041,7 @@ namespace dependencygraph {
 			case ObjectBuildingState::Failure:
 			case ObjectBuildingState::NoBuilderAvailable:
 			case ObjectBuildingState::ObjectBuilt:
+			case ObjectBuildingState::Cancelled:
 				// Can run immediately...
 				lock.unlock();
 				if (callBackFunc)
@@ -299,8 +1057,19 @@ namespace dependencygraph {
 		}
 	}
 
-	template <class TKeyType, class TValueType>
-	void ObjectBuilderInfo<TKeyType, TValueType>::launchPostDependenciesKnownCallBacks() {
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::setDependenciesKnown() {
+		this->_state = ObjectBuildingState::DependenciesKnown;
+		{
+			std::unique_lock<std::mutex> accessor(this->dependenciesKnownMutex);
+			this->dependenciesKnownCV.notify_all();
+		}
+
+		this->launchPostDependenciesKnownCallBacks();
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::launchPostDependenciesKnownCallBacks() {
 		for (auto& callBack : this->_postDependenciesKnownCallBacks) {
 			try {
 				callBack(*this);
@@ -313,8 +1082,15 @@ namespace dependencygraph {
 		this->_postDependenciesKnownCallBacks.clear();
 	}
 
-	template <class TKeyType, class TValueType>
-	void ObjectBuilderInfo<TKeyType, TValueType>::launchPostBuildCallBacks() {
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>::launchPostBuildCallBacks() {
+		auto& fusionSuppressed = currentFusionSuppressedStorage();
+		auto wasFusionSuppressed = fusionSuppressed;
+		fusionSuppressed = this->_postBuildCallBacks.size() > 1;
+
+		auto& completingNodes = currentCompletingNodesStorage();
+		completingNodes.push_back({ this, this->objectContext });
+
 		for (auto& callBack : this->_postBuildCallBacks) {
 			try {
 				callBack(*this);
@@ -324,6 +1100,13 @@ namespace dependencygraph {
 			}
 		}
 
+		completingNodes.pop_back();
+		fusionSuppressed = wasFusionSuppressed;
 		this->_postBuildCallBacks.clear();
+
+		if (this->_admissionCounted.exchange(false))
+			this->objectContext->_admissionController.NodeCompleted(this->objectContext->_jobQueue.get());
+
+		this->_completingCount.fetch_sub(1);
 	}
 }
\ No newline at end of file
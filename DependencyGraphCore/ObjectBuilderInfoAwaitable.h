@@ -0,0 +1,112 @@
+#pragma once
+
+// C++20 coroutine support, this is only available when the compiler has coroutines enabled (the rest of
+// the library only requires C++14)
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define DEPENDENCYGRAPH_HAS_COROUTINES 1
+#endif
+#endif
+
+#if defined(DEPENDENCYGRAPH_HAS_COROUTINES)
+
+#include <atomic>
+#include <coroutine>
+#include <memory>
+
+#include "IDependencyGraphJobQueue.h"
+#include "ObjectBuilderInfo.h"
+
+namespace dependencygraph {
+
+	// Awaitable which resumes the awaiting coroutine once the node has reached one of the required states,
+	// i.e. the coroutine equivalent of the node's wait handles. The result of the co_await is the node itself.
+	//
+	// If a job queue is supplied, then the coroutine is resumed through a job on that queue, otherwise it's
+	// resumed directly on the thread which completed the node, from within the node's post build call backs,
+	// in which case it mustn't reset or destroy the node's object context. If the node is already complete by
+	// the time it's awaited, then the coroutine simply continues on the awaiting thread.
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	class ObjectBuilderInfoAwaitable {
+	private:
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> _objectBuilderInfo;
+		std::shared_ptr<IDependencyGraphJobQueue> _resumeOn;
+		bool _awaitDependenciesKnown;
+
+		bool isReady() const {
+			switch (this->_objectBuilderInfo->getState()) {
+			case ObjectBuildingState::Failure:
+			case ObjectBuildingState::NoBuilderAvailable:
+			case ObjectBuildingState::ObjectBuilt:
+			case ObjectBuildingState::Cancelled:
+				return true;
+
+			case ObjectBuildingState::DependenciesKnown:
+			case ObjectBuildingState::Building:
+				return this->_awaitDependenciesKnown;
+
+			default:
+				return false;
+			}
+		}
+
+	public:
+		ObjectBuilderInfoAwaitable(std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> objectBuilderInfo, std::shared_ptr<IDependencyGraphJobQueue> resumeOn, bool awaitDependenciesKnown) :
+			_objectBuilderInfo(objectBuilderInfo),
+			_resumeOn(resumeOn),
+			_awaitDependenciesKnown(awaitDependenciesKnown) {
+		}
+
+		bool await_ready() const {
+			return this->isReady();
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			// The call back can run straight away (on this thread) if the node completes in the meantime. Whichever
+			// of the call back and ourselves gets here second is responsible for the resumption, which in our case
+			// means not suspending at all
+			auto arrived = std::make_shared<std::atomic<bool>>(false);
+			auto resumeOn = this->_resumeOn;
+			auto callBack = [arrived, resumeOn, handle](ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>& objectBuilderInfo) {
+				if (!arrived->exchange(true))
+					return;
+
+				if (resumeOn)
+					resumeOn->RegisterJob(DependencyGraphJob(DependencyGraphJobStyle::other, [handle]() { handle.resume(); }));
+				else
+					handle.resume();
+			};
+
+			if (this->_awaitDependenciesKnown)
+				this->_objectBuilderInfo->RegisterPostDependenciesKnownCallBack(std::move(callBack));
+			else
+				this->_objectBuilderInfo->RegisterPostBuildCallBack(std::move(callBack));
+
+			return !arrived->exchange(true);
+		}
+
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> await_resume() const {
+			return this->_objectBuilderInfo;
+		}
+	};
+
+	// co_await WhenBuilt(node) - resumes once the node has been built, has failed or has been cancelled
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	ObjectBuilderInfoAwaitable<TKeyType, TValueType, TBuilderPolicy> WhenBuilt(std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> objectBuilderInfo, std::shared_ptr<IDependencyGraphJobQueue> resumeOn = nullptr) {
+		return ObjectBuilderInfoAwaitable<TKeyType, TValueType, TBuilderPolicy>(objectBuilderInfo, resumeOn, false);
+	}
+
+	// co_await WhenDependenciesKnown(node) - resumes once the node's dependencies are known (or it's complete)
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	ObjectBuilderInfoAwaitable<TKeyType, TValueType, TBuilderPolicy> WhenDependenciesKnown(std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> objectBuilderInfo, std::shared_ptr<IDependencyGraphJobQueue> resumeOn = nullptr) {
+		return ObjectBuilderInfoAwaitable<TKeyType, TValueType, TBuilderPolicy>(objectBuilderInfo, resumeOn, true);
+	}
+
+	// Allows a node to be awaited directly, i.e. co_await node, which is equivalent to co_await WhenBuilt(node)
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	ObjectBuilderInfoAwaitable<TKeyType, TValueType, TBuilderPolicy> operator co_await(std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> objectBuilderInfo) {
+		return WhenBuilt(objectBuilderInfo);
+	}
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "DependencyValues.h"
+#include "IAsyncObjectBuilder.h"
+#include "IBatchObjectBuilder.h"
+#include "IObjectBuilder.h"
+#include "IObjectBuilderProvider.h"
+
+namespace dependencygraph {
+
+	// How an object context (and its nodes) resolves object builders and calls them during discovery and
+	// building. This policy goes through IObjectBuilderProvider and IObjectBuilder, i.e. virtual calls, so
+	// that any mix of builders (batch, async, overrides, etc.) can be used within the same context. See
+	// StaticObjectBuilderPolicy for graphs whose single builder is known at compile time.
+	template <class TKeyType, class TValueType>
+	class DynamicObjectBuilderPolicy {
+	public:
+		// The provider type which the object context is constructed with
+		typedef IObjectBuilderProvider<TKeyType, TValueType> Provider;
+
+		static bool TryGetObjectBuilder(IObjectBuilderProvider<TKeyType, TValueType>& objectBuilderProvider, const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
+			return objectBuilderProvider.TryGetObjectBuilder(address, objectBuilder);
+		}
+
+		static bool IsConstant(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return objectBuilder.IsConstant();
+		}
+
+		static std::vector<TKeyType> GetDependencies(IObjectBuilder<TKeyType, TValueType>& objectBuilder, const TKeyType& address) {
+			return objectBuilder.GetDependencies(address);
+		}
+
+		static TValueType BuildObject(IObjectBuilder<TKeyType, TValueType>& objectBuilder, const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) {
+			return objectBuilder.BuildObject(address, dependencies);
+		}
+
+		static IBatchObjectBuilder<TKeyType, TValueType>* GetBatchObjectBuilder(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return dynamic_cast<IBatchObjectBuilder<TKeyType, TValueType>*>(&objectBuilder);
+		}
+
+		static IAsyncObjectBuilder<TKeyType, TValueType>* GetAsyncObjectBuilder(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return dynamic_cast<IAsyncObjectBuilder<TKeyType, TValueType>*>(&objectBuilder);
+		}
+
+		// Whether a builder which didn't come from the provider (e.g. one restored from a persisted topology)
+		// can be used by the policy
+		static bool IsSupported(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return true;
+		}
+	};
+}
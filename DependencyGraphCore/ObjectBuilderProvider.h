@@ -3,31 +3,51 @@
 #include <functional>
 #include <unordered_map>
 
+#include "ConstantObjectBuilder.h"
 #include "IObjectBuilder.h"
+#include "IObjectBuilderProvider.h"
 
 namespace dependencygraph {
 	template <class TKeyType, class TValueType>
 	class ObjectBuilderProvider : public IObjectBuilderProvider<TKeyType, TValueType> {
 	public:
 		std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> addressSpecificBuilders;
+
+		// Deprecated, use RegisterOverride instead. A new constant builder (and copy of the value) is created
+		// from these on every lookup, so the nodes of overridden addresses never share a builder, e.g. they
+		// can't be matched against a persisted topology's builders. Overrides registered through
+		// RegisterOverride take precedence
 		std::unordered_map<TKeyType, TValueType> addressSpecificOverrides;
 		std::function<bool(const TKeyType&, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>&)> builderProviderFunc;
 
+		// Overrides the value of an address. The constant builder is created here, once, rather than on every
+		// lookup, so the value type must be copyable. Overrides should be registered / removed before the
+		// provider is used by an object context
+		void RegisterOverride(const TKeyType& address, const TValueType& value);
+		void RemoveOverride(const TKeyType& address);
+
 		// IObjectBuilderProvider functionality
 		bool TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) override;
+		bool TryGetOverrideObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) override;
 
 	private:
-
+		std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> _overrideBuilders;
 	};
 
+	template <class TKeyType, class TValueType>
+	void ObjectBuilderProvider<TKeyType, TValueType>::RegisterOverride(const TKeyType& address, const TValueType& value) {
+		this->_overrideBuilders[address] = MakeConstantObjectBuilder<TKeyType, TValueType>(value);
+	}
+
+	template <class TKeyType, class TValueType>
+	void ObjectBuilderProvider<TKeyType, TValueType>::RemoveOverride(const TKeyType& address) {
+		this->_overrideBuilders.erase(address);
+	}
+
 	template <class TKeyType, class TValueType>
 	bool ObjectBuilderProvider<TKeyType, TValueType>::TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
-		{
-			auto itr = this->addressSpecificOverrides.find(address);
-			if (itr != this->addressSpecificOverrides.end()) {
-				// TODO - wrap and return
-			}
-		}
+		if (this->TryGetOverrideObjectBuilder(address, objectBuilder))
+			return true;
 
 		{
 			auto itr = this->addressSpecificBuilders.find(address);
@@ -47,4 +67,23 @@ namespace dependencygraph {
 		objectBuilder = nullptr;
 		return false;
 	}
+
+	template <class TKeyType, class TValueType>
+	bool ObjectBuilderProvider<TKeyType, TValueType>::TryGetOverrideObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
+		auto overrideItr = this->_overrideBuilders.find(address);
+		if (overrideItr != this->_overrideBuilders.end()) {
+			objectBuilder = overrideItr->second;
+			return true;
+		}
+
+		if (this->addressSpecificOverrides.empty())
+			return false;
+
+		auto itr = this->addressSpecificOverrides.find(address);
+		if (itr == this->addressSpecificOverrides.end())
+			return false;
+
+		objectBuilder = MakeConstantObjectBuilder<TKeyType, TValueType>(itr->second);
+		return true;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "ConstantObjectBuilder.h"
+#include "IObjectBuilder.h"
+#include "IObjectBuilderProvider.h"
+
+namespace dependencygraph {
+
+	// Object builder provider which maps addresses onto key classes, with all addresses of the same key
+	// class sharing a single object builder instance.
+	//
+	// Resolution is performed in the following order:
+	//  1. Overrides (see RegisterOverride) - returned as a constant builder so the node is never scheduled
+	//  2. addressSpecificBuilders
+	//  3. The builder for the address' key class (from keyClassFunc), either registered through RegisterBuilder
+	//     or created once by builderFactoryFunc and then cached
+	//
+	// Unlike ObjectBuilderProvider::builderProviderFunc, which is called for every single address, the
+	// factory is only called once per key class so that resolving a builder isn't a per node allocation.
+	template <class TKeyType, class TValueType, class TKeyClass = TKeyType>
+	class ObjectBuilderRegistry : public IObjectBuilderProvider<TKeyType, TValueType> {
+	public:
+		std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> addressSpecificBuilders;
+
+		std::function<TKeyClass(const TKeyType&)> keyClassFunc;
+		std::function<bool(const TKeyClass&, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>&)> builderFactoryFunc;
+
+		void RegisterBuilder(const TKeyClass& keyClass, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder);
+
+		// Overrides the value of an address. The constant builder is created here, once, rather than on every
+		// lookup, so the value type must be copyable. Overrides should be registered / removed before the
+		// registry is used by an object context
+		void RegisterOverride(const TKeyType& address, const TValueType& value);
+		void RemoveOverride(const TKeyType& address);
+
+		// IObjectBuilderProvider functionality
+		bool TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) override;
+		bool TryGetOverrideObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) override;
+
+	private:
+		std::unordered_map<TKeyType, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> _overrideBuilders;
+
+		// Cache of resolved builders by key class, a null entry means that the factory couldn't supply one
+		std::unordered_map<TKeyClass, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> _keyClassBuilders;
+		std::mutex _keyClassBuildersAccessMutex;
+	};
+
+	template <class TKeyType, class TValueType, class TKeyClass>
+	void ObjectBuilderRegistry<TKeyType, TValueType, TKeyClass>::RegisterBuilder(const TKeyClass& keyClass, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder) {
+		std::unique_lock<std::mutex> lock(this->_keyClassBuildersAccessMutex);
+		this->_keyClassBuilders[keyClass] = objectBuilder;
+	}
+
+	template <class TKeyType, class TValueType, class TKeyClass>
+	void ObjectBuilderRegistry<TKeyType, TValueType, TKeyClass>::RegisterOverride(const TKeyType& address, const TValueType& value) {
+		this->_overrideBuilders[address] = MakeConstantObjectBuilder<TKeyType, TValueType>(value);
+	}
+
+	template <class TKeyType, class TValueType, class TKeyClass>
+	void ObjectBuilderRegistry<TKeyType, TValueType, TKeyClass>::RemoveOverride(const TKeyType& address) {
+		this->_overrideBuilders.erase(address);
+	}
+
+	template <class TKeyType, class TValueType, class TKeyClass>
+	bool ObjectBuilderRegistry<TKeyType, TValueType, TKeyClass>::TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
+		if (this->TryGetOverrideObjectBuilder(address, objectBuilder))
+			return true;
+
+		{
+			auto itr = this->addressSpecificBuilders.find(address);
+			if (itr != this->addressSpecificBuilders.end()) {
+				objectBuilder = itr->second;
+				return true;
+			}
+		}
+
+		if (this->keyClassFunc) {
+			auto keyClass = this->keyClassFunc(address);
+
+			std::unique_lock<std::mutex> lock(this->_keyClassBuildersAccessMutex);
+			auto itr = this->_keyClassBuilders.find(keyClass);
+			if (itr != this->_keyClassBuilders.end()) {
+				objectBuilder = itr->second;
+				return (bool)objectBuilder;
+			}
+
+			// Create whilst holding the lock so that all addresses of the same class end up with the same instance
+			std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> newObjectBuilder;
+			if (!this->builderFactoryFunc || !this->builderFactoryFunc(keyClass, newObjectBuilder))
+				newObjectBuilder = nullptr;
+
+			this->_keyClassBuilders[keyClass] = newObjectBuilder;
+			objectBuilder = newObjectBuilder;
+			return (bool)objectBuilder;
+		}
+
+		objectBuilder = nullptr;
+		return false;
+	}
+
+	template <class TKeyType, class TValueType, class TKeyClass>
+	bool ObjectBuilderRegistry<TKeyType, TValueType, TKeyClass>::TryGetOverrideObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
+		auto itr = this->_overrideBuilders.find(address);
+		if (itr == this->_overrideBuilders.end())
+			return false;
+
+		objectBuilder = itr->second;
+		return true;
+	}
+}
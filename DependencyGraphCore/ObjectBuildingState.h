@@ -7,6 +7,10 @@ namespace dependencygraph {
 		DependenciesKnown,
 		ObjectBuilt,
 		Failure,
+		Cancelled,
+
+		// An asynchronous build has been started and is yet to complete
+		Building,
 	};
 
 
@@ -27,6 +31,12 @@ namespace dependencygraph {
 		case ObjectBuildingState::Failure:
 			return L"Failure";
 
+		case ObjectBuildingState::Cancelled:
+			return L"Cancelled";
+
+		case ObjectBuildingState::Building:
+			return L"Building";
+
 		default:
 			return L"Unknown";
 		}
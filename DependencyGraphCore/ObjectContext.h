@@ -1,11 +1,20 @@
 #pragma once
 
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 
+#include "AdmissionController.h"
+#include "BatchBuildCollector.h"
+#include "BuildCostModel.h"
+#include "BuildMemo.h"
+#include "CancellationToken.h"
 #include "IDependencyGraphJobQueue.h"
+#include "IDependencyGraphLogSink.h"
 #include "IObjectBuilderProvider.h"
 #include "ObjectBuilderInfo.h"
+#include "ObjectBuilderInfoAwaitable.h"
 
 namespace dependencygraph {
 
@@ -14,91 +23,457 @@ namespace dependencygraph {
 	/// </summary>
 	/// <typeparam name="TKeyType"The type of the address></typeparam>
 	/// <typeparam name="TValueType">The type of nodes within the graph</typeparam>
-	template <class TKeyType, class TValueType>
+	/// <typeparam name="TBuilderPolicy">How the builders are resolved and called (see DynamicObjectBuilderPolicy)</typeparam>
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
 	class ObjectContext {
 	public:
 		ObjectContext(
-			std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> objectBuilderProvider,
+			std::shared_ptr<typename TBuilderPolicy::Provider> objectBuilderProvider,
 			std::shared_ptr<IDependencyGraphJobQueue> jobQueue);
+		~ObjectContext();
 
-		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>> GetDependencies(const TKeyType& address);
-		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>> BuildObject(const TKeyType& address);
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> GetDependencies(const TKeyType& address);
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> BuildObject(const TKeyType& address);
+
+		// Requests that the object be built, with the request being abandoned once the token has been
+		// cancelled or its deadline passes. Nodes which are only needed by abandoned requests are not
+		// scheduled and are reported as ObjectBuildingState::Cancelled
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> BuildObject(const TKeyType& address, std::shared_ptr<CancellationToken> cancellationToken);
+
+#if defined(DEPENDENCYGRAPH_HAS_COROUTINES)
+		// Requests that the object be built, for use as co_await objectContext.Build(address), with the result being
+		// the node once it's complete. The coroutine is resumed through resumeOn if supplied, otherwise on the thread
+		// which completed the node
+		ObjectBuilderInfoAwaitable<TKeyType, TValueType, TBuilderPolicy> Build(const TKeyType& address, std::shared_ptr<IDependencyGraphJobQueue> resumeOn = nullptr, std::shared_ptr<CancellationToken> cancellationToken = nullptr) {
+			return WhenBuilt(this->BuildObject(address, cancellationToken), resumeOn);
+		}
+#endif
+
+		// The model used to measure build costs and decide which nodes are cheap enough to be built inline (fused)
+		// rather than being scheduled separately, defaults to BuildCostModel::GetDefault(). Set to nullptr to
+		// disable both measuring and fusion. Should be set before any objects are requested
+		void SetBuildCostModel(std::shared_ptr<BuildCostModel> buildCostModel) {
+			this->_buildCostModel = buildCostModel;
+		}
+
+		std::shared_ptr<BuildCostModel> GetBuildCostModel() const {
+			return this->_buildCostModel;
+		}
+
+		// Whether this context's cheap nodes may be fused (see BuildCostModel), build costs are measured regardless.
+		// Enabled by default, can be changed at any time with nodes which are already scheduled being unaffected
+		void SetFusionEnabled(bool fusionEnabled) {
+			this->_fusionEnabled.store(fusionEnabled, std::memory_order_relaxed);
+		}
+
+		bool IsFusionEnabled() const {
+			return this->_fusionEnabled.load(std::memory_order_relaxed);
+		}
+
+		// Limits on the number of in-flight nodes / queued jobs, beyond which further requests are held back
+		// until there's capacity (see AdmissionLimits). Unlimited by default, should be set before any objects
+		// are requested
+		void SetAdmissionLimits(const AdmissionLimits& admissionLimits) {
+			this->_admissionController.SetLimits(admissionLimits);
+		}
+
+		const AdmissionController& GetAdmissionController() const {
+			return this->_admissionController;
+		}
+
+		// Where failures are reported, i.e. nodes whose discovery / build threw. Only the node where a failure
+		// originates is reported, not its dependents. Nothing is logged by default, use WideStreamLogSink to
+		// log to the console. Should be set before any objects are requested
+		void SetLogSink(std::shared_ptr<IDependencyGraphLogSink> logSink) {
+			this->_logSink = logSink;
+		}
+
+		// Memo of builds keyed by builder and dependency values (see BuildMemo), which may be shared with other
+		// object contexts. None by default. Should be set before any objects are requested
+		void SetBuildMemo(std::shared_ptr<BuildMemo<TKeyType, TValueType>> buildMemo) {
+			this->_buildMemo = buildMemo;
+		}
+
+		std::shared_ptr<BuildMemo<TKeyType, TValueType>> GetBuildMemo() const {
+			return this->_buildMemo;
+		}
+
+		// Returns the context to its initial state so that it can be used for another run, clearing every node's
+		// state and value but keeping the nodes themselves (along with their dependency and call back storage)
+		// and the dictionary's capacity. Building the same, or a similar, graph again then avoids allocating and
+		// destroying the nodes.
+		//
+		// No builds may be in progress (an exception is thrown if they are), and as the nodes are reused, any
+		// nodes or values obtained before the reset mustn't be used afterwards
+		void Reset();
+
+		// Returns the node for the address if it's already known to the context, without creating or discovering it
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> TryGetObjectBuilderInfo(const TKeyType& address);
+
+		// Returns (a snapshot of) all of the nodes known to the context, in no particular order
+		std::vector<std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>> GetKnownNodes();
+
+		std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> GetObjectBuilderProvider() const {
+			return this->_objectBuilderProvider;
+		}
+
+		// Restores nodes whose discovery has already been done elsewhere (e.g. a persisted topology, see
+		// GraphTopology.h) without going through the provider or the builders' GetDependencies. Nodes are
+		// created for all of the addresses in one go, and those with a builder are marked as discovered, the
+		// dependencies of the i'th being addresses[edges[j]] for j in [edgeOffsets[i], edgeOffsets[i + 1]).
+		// Nodes without a builder (or with a constant one, or which have already been discovered, or which the
+		// provider has an override for, see IObjectBuilderProvider::TryGetOverrideObjectBuilder) are left to be
+		// discovered as usual. Returns the number of nodes which were restored. The edges must be in range,
+		// and this should be called before any objects are requested
+		size_t RestoreDiscoveredNodes(
+			const std::vector<TKeyType>& addresses,
+			const std::vector<std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>>& objectBuilders,
+			const std::uint64_t* edgeOffsets,
+			const std::uint32_t* edges);
 
 	protected:
-		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>> GetDependenciesInt(const TKeyType& address);
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> GetDependenciesInt(const TKeyType& address);
 
 	private:
+		friend class ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>;
+
+		std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> getOrCreateNode(const TKeyType& address);
+		void discoverNode(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi);
+		void requestBuildObjectInt(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi, std::shared_ptr<IDependencyGraphJobQueue>& jobQueue, const std::shared_ptr<CancellationToken>& cancellationToken);
+		void admitRequests(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi);
+
+		void registerReadyBatchObject(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi, IBatchObjectBuilder<TKeyType, TValueType>* batchObjectBuilder, std::shared_ptr<IDependencyGraphJobQueue>& jobQueue) {
+			this->_batchBuildCollector.RegisterReadyObject(obi, batchObjectBuilder, jobQueue);
+		}
+
+
 		std::shared_ptr<IDependencyGraphJobQueue> _jobQueue;
 		std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> _objectBuilderProvider;
 
-		std::unordered_map<TKeyType, std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>>> _values;
+		std::unordered_map<TKeyType, std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>> _values;
 		std::mutex _valuesDictionaryAccessMutex;
+
+		BatchBuildCollector<TKeyType, TValueType, TBuilderPolicy> _batchBuildCollector;
+		std::shared_ptr<BuildCostModel> _buildCostModel;
+		std::atomic<bool> _fusionEnabled;
+		AdmissionController _admissionController;
+
+		// The cancellation tokens of the requests which are queued for admission, per node, so that repeated
+		// requests for a node which hasn't been admitted yet don't queue it again
+		std::unordered_map<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*, std::vector<std::shared_ptr<CancellationToken>>> _pendingAdmissions;
+		std::mutex _pendingAdmissionsMutex;
+		std::shared_ptr<IDependencyGraphLogSink> _logSink;
+		std::shared_ptr<BuildMemo<TKeyType, TValueType>> _buildMemo;
 	};
 
-	template <class TKeyType, class TValueType>
-	ObjectContext<TKeyType, TValueType>::ObjectContext(
-		std::shared_ptr<IObjectBuilderProvider<TKeyType, TValueType>> objectBuilderProvider,
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	ObjectContext<TKeyType, TValueType, TBuilderPolicy>::ObjectContext(
+		std::shared_ptr<typename TBuilderPolicy::Provider> objectBuilderProvider,
 		std::shared_ptr<IDependencyGraphJobQueue> jobQueue) :
 		_objectBuilderProvider(objectBuilderProvider),
-		_jobQueue(jobQueue){
+		_jobQueue(jobQueue),
+		_buildCostModel(BuildCostModel::GetDefault()),
+		_fusionEnabled(true) {
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	ObjectContext<TKeyType, TValueType, TBuilderPolicy>::~ObjectContext() {
+		this->_admissionController.StopRechecks();
+
+		// Whoever was waiting on a node may let go of the context whilst the thread which completed the node is
+		// still running its call backs. The calling thread's own call backs can't be waited for, so the context
+		// mustn't be destroyed from within the call backs of its own nodes (e.g. by a coroutine which was resumed
+		// inline, supply a job queue to resume on instead) as they'd carry on with the destroyed nodes
+		for (auto& value : this->_values) {
+			value.second->detachCompletionWaiter();
+			value.second->waitForCallBacks();
+		}
 	}
 
-	template <class TKeyType, class TValueType>
-	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>> ObjectContext<TKeyType, TValueType>::GetDependencies(const TKeyType& address) {
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> ObjectContext<TKeyType, TValueType, TBuilderPolicy>::GetDependencies(const TKeyType& address) {
 		return this->GetDependenciesInt(address);
 	}
 
-	template <class TKeyType, class TValueType>
-	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>>  ObjectContext<TKeyType, TValueType>::GetDependenciesInt(const TKeyType& address) {
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>  ObjectContext<TKeyType, TValueType, TBuilderPolicy>::GetDependenciesInt(const TKeyType& address) {
+		auto ptr = this->getOrCreateNode(address);
+		this->discoverNode(ptr.get());
+		return ptr;
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> ObjectContext<TKeyType, TValueType, TBuilderPolicy>::TryGetObjectBuilderInfo(const TKeyType& address) {
+		std::unique_lock<std::mutex> lock(this->_valuesDictionaryAccessMutex);
+		auto itr = this->_values.find(address);
+		if (itr != this->_values.end())
+			return itr->second;
+
+		return nullptr;
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::vector<std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>> ObjectContext<TKeyType, TValueType, TBuilderPolicy>::GetKnownNodes() {
+		std::vector<std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>> nodes;
+
+		std::unique_lock<std::mutex> lock(this->_valuesDictionaryAccessMutex);
+		nodes.reserve(this->_values.size());
+		for (auto& value : this->_values)
+			nodes.push_back(value.second);
+
+		return nodes;
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectContext<TKeyType, TValueType, TBuilderPolicy>::Reset() {
+		// The node would be reset whilst its call backs were still being run
+		for (auto& completingNode : currentCompletingNodesStorage()) {
+			if (completingNode.objectContext == this)
+				throw std::exception("Cannot reset an object context from within the call backs of its own objects");
+		}
+
+		if (this->_admissionController.HasPendingRequests())
+			throw std::exception("Cannot reset an object context whilst objects are being built");
+
+		std::unique_lock<std::mutex> lock(this->_valuesDictionaryAccessMutex);
+		for (auto& value : this->_values) {
+			if (value.second->isBuildInProgress())
+				throw std::exception("Cannot reset an object context whilst objects are being built");
+		}
+
+		for (auto& value : this->_values)
+			value.second->reset();
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	size_t ObjectContext<TKeyType, TValueType, TBuilderPolicy>::RestoreDiscoveredNodes(
+		const std::vector<TKeyType>& addresses,
+		const std::vector<std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>>& objectBuilders,
+		const std::uint64_t* edgeOffsets,
+		const std::uint32_t* edges) {
+		std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> nodes(addresses.size());
 		{
 			std::unique_lock<std::mutex> lock(this->_valuesDictionaryAccessMutex);
-			auto itr = this->_values.find(address);
-			if (itr != this->_values.end())
-				return itr->second;
+			this->_values.reserve(this->_values.size() + addresses.size());
+			for (size_t i = 0; i < addresses.size(); ++i) {
+				auto& ptr = this->_values[addresses[i]];
+				if (!ptr)
+					ptr = std::make_shared<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>(this, addresses[i]);
+
+				nodes[i] = ptr.get();
+			}
+		}
+
+		// Builders are typically shared by many nodes, so only look up their costs once
+		std::unordered_map<const IObjectBuilder<TKeyType, TValueType>*, std::shared_ptr<BuilderBuildCost>> buildCosts;
 
-			// Create a new entry and store this...
-			auto ptr = std::make_shared<ObjectBuilderInfo<TKeyType, TValueType>>(this, address);
-			this->_values[address] = ptr;
+		size_t restoredCount(0);
+		std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> overrideObjectBuilder;
+		for (size_t i = 0; i < addresses.size(); ++i) {
+			auto objectBuilder = objectBuilders[i];
+			if (!objectBuilder || objectBuilder->IsConstant() || !TBuilderPolicy::IsSupported(*objectBuilder))
+				continue;
 
-			// At this point, we now need to kick off the rest of the population work, but we do not 
-			// have to be locked as this is not a requirement anymore...
-			lock.unlock();
+			// Overrides are only known to the provider
+			if (this->_objectBuilderProvider->TryGetOverrideObjectBuilder(addresses[i], overrideObjectBuilder))
+				continue;
 
-			// Check to see if this is an object which we think we can build at this specific ObjectContext
-			// level, otherwise look to our parents to see if we can do it.
+			auto ptr = nodes[i];
+			if (ptr->_discoveryStarted.exchange(true))
+				continue;
 
-			std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder;
-			if (!this->_objectBuilderProvider->TryGetObjectBuilder(address, objectBuilder)) {
+			ptr->SetObjectBuilder(objectBuilder);
 
-				// TODO - Update this to allow for inheriting items / item specifications from a parent context
-				// Register unable to do anything here...
-				ptr->SetNoBuilderFound();
+			if (this->_buildCostModel && !ptr->_batchObjectBuilder) {
+				auto& buildCost = buildCosts[objectBuilder.get()];
+				if (!buildCost)
+					buildCost = this->_buildCostModel->GetBuilderBuildCost(objectBuilder);
+				ptr->_buildCost = buildCost;
 			}
-			else {
-				// Register the object builder and start the discovery process
-				ptr->SetObjectBuilder(objectBuilder);
-
-				try
-				{
-					auto dependencies = objectBuilder->GetDependencies(address);
-					ptr->SetRequestedDependencies(std::move(dependencies));
-				}
-				catch (...)
-				{
-					std::wcout << L"Dependency Failed(" << address << L")" << std::endl;
-					auto exception = std::make_shared<std::exception>("Discovery failed");
-					ptr->SetObjectFailed(exception);
+
+			std::vector<TKeyType> dependencies;
+			std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> dependencyNodes;
+			dependencies.reserve((size_t)(edgeOffsets[i + 1] - edgeOffsets[i]));
+			dependencyNodes.reserve((size_t)(edgeOffsets[i + 1] - edgeOffsets[i]));
+			for (auto edge = edgeOffsets[i]; edge < edgeOffsets[i + 1]; ++edge) {
+				dependencies.push_back(addresses[edges[edge]]);
+				dependencyNodes.push_back(nodes[edges[edge]]);
+			}
+
+			ptr->SetRequestedDependencies(std::move(dependencies), std::move(dependencyNodes));
+			restoredCount++;
+		}
+
+		return restoredCount;
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> ObjectContext<TKeyType, TValueType, TBuilderPolicy>::getOrCreateNode(const TKeyType& address) {
+		std::unique_lock<std::mutex> lock(this->_valuesDictionaryAccessMutex);
+		auto itr = this->_values.find(address);
+		if (itr != this->_values.end())
+			return itr->second;
+
+		// Create a new entry and store this...
+		auto ptr = std::make_shared<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>(this, address);
+		this->_values[address] = ptr;
+		return ptr;
+	}
+
+	// Performs the discovery for a node (exactly once), i.e. finding its builder and its dependencies. Each
+	// dependency is resolved into a direct reference to its node here, so that the scheduling and building
+	// which follows doesn't need to go back to the dictionary. Note that the dependency nodes are only
+	// created at this point, they will be discovered themselves as and when they're needed.
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectContext<TKeyType, TValueType, TBuilderPolicy>::discoverNode(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* ptr) {
+		if (ptr->_discoveryStarted.exchange(true))
+			return;
+
+		auto& address = ptr->key;
+
+		// Check to see if this is an object which we think we can build at this specific ObjectContext
+		// level, otherwise look to our parents to see if we can do it.
+
+		std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder;
+		if (!TBuilderPolicy::TryGetObjectBuilder(*this->_objectBuilderProvider, address, objectBuilder)) {
+
+			// TODO - Update this to allow for inheriting items / item specifications from a parent context
+			// Register unable to do anything here...
+			ptr->SetNoBuilderFound();
+			return;
+		}
+
+		// Register the object builder and start the discovery process
+		ptr->SetObjectBuilder(objectBuilder);
+
+		if (TBuilderPolicy::IsConstant(*objectBuilder)) {
+			try
+			{
+				DependencyValues<TKeyType, TValueType> noDependencies(nullptr, nullptr, 0);
+				ptr->SetObjectOverridden(objectBuilder->BuildObject(address, noDependencies));
+			}
+			catch (...)
+			{
+				auto exceptionPtr = std::current_exception();
+				ptr->logFailure(L"Override failed", exceptionPtr);
+
+				auto exception = std::make_shared<std::exception>("Override failed");
+				ptr->SetObjectFailed(exception, exceptionPtr);
+			}
+			return;
+		}
+
+		if (this->_buildCostModel && !ptr->_batchObjectBuilder)
+			ptr->_buildCost = this->_buildCostModel->GetBuilderBuildCost(objectBuilder);
+
+		try
+		{
+			auto dependencies = TBuilderPolicy::GetDependencies(*objectBuilder, address);
+
+			std::vector<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>*> dependencyNodes;
+			dependencyNodes.reserve(dependencies.size());
+			{
+				std::unique_lock<std::mutex> lock(this->_valuesDictionaryAccessMutex);
+				for (auto& dependency : dependencies) {
+					auto& dependencyPtr = this->_values[dependency];
+					if (!dependencyPtr)
+						dependencyPtr = std::make_shared<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>>(this, dependency);
+
+					dependencyNodes.push_back(dependencyPtr.get());
 				}
 			}
 
-			return ptr;
+			ptr->SetRequestedDependencies(std::move(dependencies), std::move(dependencyNodes));
+		}
+		catch (...)
+		{
+			auto exceptionPtr = std::current_exception();
+			ptr->logFailure(L"Discovery failed", exceptionPtr);
+
+			auto exception = std::make_shared<std::exception>("Discovery failed");
+			ptr->SetObjectFailed(exception, exceptionPtr);
+		}
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectContext<TKeyType, TValueType, TBuilderPolicy>::requestBuildObjectInt(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi, std::shared_ptr<IDependencyGraphJobQueue>& jobQueue, const std::shared_ptr<CancellationToken>& cancellationToken) {
+		this->discoverNode(obi);
+		obi->RequestBuildObject(jobQueue, cancellationToken);
+	}
+
+	// Requests the node for all of the requests which were queued for it whilst it was waiting to be admitted.
+	// A failure fails the node rather than escaping, as the request's caller has already been given the node
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	void ObjectContext<TKeyType, TValueType, TBuilderPolicy>::admitRequests(ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>* obi) {
+		std::vector<std::shared_ptr<CancellationToken>> cancellationTokens;
+		{
+			std::unique_lock<std::mutex> lock(this->_pendingAdmissionsMutex);
+			auto itr = this->_pendingAdmissions.find(obi);
+			if (itr == this->_pendingAdmissions.end())
+				return;
+
+			cancellationTokens.swap(itr->second);
+			this->_pendingAdmissions.erase(itr);
+		}
+
+		try
+		{
+			this->discoverNode(obi);
+			for (auto& cancellationToken : cancellationTokens)
+				obi->RequestBuildObject(this->_jobQueue, cancellationToken);
+		}
+		catch (...)
+		{
+			auto exceptionPtr = std::current_exception();
+			obi->logFailure(L"Failed to admit object", exceptionPtr);
+
+			auto exception = std::make_shared<std::exception>("Failed to admit object");
+			obi->SetObjectFailed(exception, exceptionPtr);
 		}
 	}
 
-	template <class TKeyType, class TValueType>
-	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType>> ObjectContext<TKeyType, TValueType>::BuildObject(const TKeyType& address) {
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> ObjectContext<TKeyType, TValueType, TBuilderPolicy>::BuildObject(const TKeyType& address) {
+		return this->BuildObject(address, nullptr);
+	}
+
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::shared_ptr<ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>> ObjectContext<TKeyType, TValueType, TBuilderPolicy>::BuildObject(const TKeyType& address, std::shared_ptr<CancellationToken> cancellationToken) {
+		if (this->_admissionController.IsEnabled()) {
+			auto obi = this->getOrCreateNode(address);
+
+			// Requests for nodes which have already been requested don't add any work
+			if (obi->_buildRequestCount.load() == 0) {
+				// Threads which are running a job or completing a node may be the ones which would free up the
+				// capacity, so they mustn't block on it
+				auto canBlock = GetCurrentJobQueue() == nullptr && currentCompletingNodesStorage().empty();
+				if (this->_admissionController.GetLimits().blockSubmission && canBlock) {
+					this->_admissionController.WaitForCapacity(this->_jobQueue.get());
+				}
+				else {
+					{
+						std::unique_lock<std::mutex> lock(this->_pendingAdmissionsMutex);
+						auto& cancellationTokens = this->_pendingAdmissions[obi.get()];
+						cancellationTokens.push_back(cancellationToken);
+						if (cancellationTokens.size() > 1)
+							return obi;
+					}
+
+					// Queued, with the discovery also being held back until the request is admitted
+					auto admitted = this->_admissionController.TryAdmitOrQueue(this->_jobQueue.get(), [this, obi]() {
+						this->admitRequests(obi.get());
+						});
+
+					if (admitted)
+						this->admitRequests(obi.get());
+
+					return obi;
+				}
+			}
+		}
+
 		auto obi = this->GetDependenciesInt(address);
-		obi->RequestBuildObject(this->_jobQueue);
+		obi->RequestBuildObject(this->_jobQueue, cancellationToken);
 		return obi;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ObjectContext.h"
+
+namespace dependencygraph {
+
+	// The parallelism available within a (discovered) object context, based off the shape of the graph and the
+	// cost of each node, i.e. the work / span model:
+	//
+	//	work - the total cost of all of the nodes, i.e. the time taken on a single thread
+	//	span - the cost of the most expensive chain of dependencies (the critical path), i.e. the time taken
+	//		with unlimited threads
+	//
+	// No schedule on N threads can take less than max(work / N, span), and a greedy scheduler takes no more
+	// than work / N + span. Comparing these against the measured elapsed time separates the limits of the
+	// graph itself from the overhead of the engine (scheduling, contention etc.).
+	template <class TKeyType>
+	struct ParallelismAnalysis {
+	public:
+		size_t nodeCount;
+
+		std::chrono::nanoseconds work;
+		std::chrono::nanoseconds span;
+
+		// The nodes on the critical path, from the first to be built to the last
+		std::vector<TKeyType> criticalPath;
+
+		// The number of nodes at each level, where a node's level is one more than that of its deepest
+		// dependency (nodes without dependencies being at level 0)
+		std::vector<size_t> widthPerLevel;
+
+		// The time from the first build starting to the last build completing, for those nodes which have been
+		// built, zero if none have
+		std::chrono::nanoseconds measuredElapsed;
+
+		ParallelismAnalysis() :
+			nodeCount(0),
+			work(0),
+			span(0),
+			measuredElapsed(0) {
+		}
+
+		// work / span, i.e. the maximum speedup regardless of the number of threads
+		double GetAverageParallelism() const {
+			return this->span.count() > 0 ? (double)this->work.count() / (double)this->span.count() : 0.0;
+		}
+
+		// The best possible elapsed time on the given number of threads, max(work / N, span)
+		std::chrono::nanoseconds GetIdealElapsed(int threadCount) const {
+			return std::max(std::chrono::nanoseconds(this->work.count() / std::max(threadCount, 1)), this->span);
+		}
+
+		// Upper bound on the elapsed time for a greedy scheduler (Brent's bound), work / N + span
+		std::chrono::nanoseconds GetGreedyElapsedBound(int threadCount) const {
+			return std::chrono::nanoseconds(this->work.count() / std::max(threadCount, 1)) + this->span;
+		}
+
+		double GetIdealSpeedup(int threadCount) const {
+			auto idealElapsed = this->GetIdealElapsed(threadCount);
+			return idealElapsed.count() > 0 ? (double)this->work.count() / (double)idealElapsed.count() : 0.0;
+		}
+
+		// work / measured elapsed time, i.e. the speedup which was actually achieved
+		double GetMeasuredSpeedup() const {
+			return this->measuredElapsed.count() > 0 ? (double)this->work.count() / (double)this->measuredElapsed.count() : 0.0;
+		}
+	};
+
+	// The measured build time of the node, zero for nodes which haven't been built (or were overridden)
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	std::chrono::nanoseconds MeasuredNodeCost(const ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy>& objectBuilderInfo) {
+		if (objectBuilderInfo.buildEndTime <= objectBuilderInfo.buildStartTime)
+			return std::chrono::nanoseconds(0);
+
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(objectBuilderInfo.buildEndTime - objectBuilderInfo.buildStartTime);
+	}
+
+	// Analyses the nodes which are currently known to the object context. Each node's cost comes from
+	// nodeCostFunc (const ObjectBuilderInfo& -> std::chrono::nanoseconds), so the graph can be analysed with
+	// estimated costs ahead of building it (e.g. a unit cost to look at the shape alone) or with the measured
+	// costs afterwards (MeasuredNodeCost, see below).
+	//
+	// Nodes whose dependencies haven't been discovered are treated as not having any. The context shouldn't
+	// be being discovered whilst it's being analysed.
+	template <class TKeyType, class TValueType, class TBuilderPolicy, class TNodeCostFunc>
+	ParallelismAnalysis<TKeyType> AnalyseParallelism(ObjectContext<TKeyType, TValueType, TBuilderPolicy>& objectContext, TNodeCostFunc nodeCostFunc) {
+		typedef ObjectBuilderInfo<TKeyType, TValueType, TBuilderPolicy> node;
+
+		ParallelismAnalysis<TKeyType> analysis;
+
+		auto nodes = objectContext.GetKnownNodes();
+		analysis.nodeCount = nodes.size();
+		if (nodes.empty())
+			return analysis;
+
+		std::unordered_map<const node*, size_t> nodeIndices;
+		nodeIndices.reserve(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i)
+			nodeIndices[nodes[i].get()] = i;
+
+		// Per node: the cost, the cost of the most expensive chain ending at the node (inclusive), the
+		// dependency on that chain and the level
+		std::vector<long long> costs(nodes.size());
+		std::vector<long long> finishTimes(nodes.size(), -1);
+		std::vector<size_t> criticalDependencies(nodes.size(), (size_t)-1);
+		std::vector<size_t> levels(nodes.size(), 0);
+
+		auto firstBuildStart = std::chrono::steady_clock::time_point::max();
+		auto lastBuildEnd = std::chrono::steady_clock::time_point::min();
+
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			auto& objectBuilderInfo = *nodes[i];
+			costs[i] = std::chrono::nanoseconds(nodeCostFunc(objectBuilderInfo)).count();
+			analysis.work += std::chrono::nanoseconds(costs[i]);
+
+			if (objectBuilderInfo.buildEndTime > objectBuilderInfo.buildStartTime) {
+				firstBuildStart = std::min(firstBuildStart, objectBuilderInfo.buildStartTime);
+				lastBuildEnd = std::max(lastBuildEnd, objectBuilderInfo.buildEndTime);
+			}
+		}
+
+		if (lastBuildEnd > firstBuildStart)
+			analysis.measuredElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(lastBuildEnd - firstBuildStart);
+
+		auto getDependencyNodes = [](const node& objectBuilderInfo) -> const std::vector<node*>& {
+			static const std::vector<node*> noDependencies;
+			switch (objectBuilderInfo.getState()) {
+			case ObjectBuildingState::DependenciesKnown:
+			case ObjectBuildingState::Building:
+			case ObjectBuildingState::ObjectBuilt:
+			case ObjectBuildingState::Cancelled:
+				return objectBuilderInfo.dependencyNodes;
+
+			default:
+				return noDependencies;
+			}
+		};
+
+		// Depth first, with an explicit stack as the graphs can be far deeper than the call stack allows
+		std::vector<std::pair<size_t, size_t>> stack;
+		for (size_t root = 0; root < nodes.size(); ++root) {
+			if (finishTimes[root] >= 0)
+				continue;
+
+			finishTimes[root] = 0;
+			stack.push_back(std::make_pair(root, (size_t)0));
+			while (!stack.empty()) {
+				auto& current = stack.back();
+				auto& dependencyNodes = getDependencyNodes(*nodes[current.first]);
+
+				// Visit the next unvisited dependency first
+				bool descended(false);
+				while (current.second < dependencyNodes.size()) {
+					auto dependencyItr = nodeIndices.find(dependencyNodes[current.second++]);
+					if (dependencyItr == nodeIndices.end() || finishTimes[dependencyItr->second] >= 0)
+						continue;
+
+					// Mark as in progress so that cycles don't loop forever
+					finishTimes[dependencyItr->second] = 0;
+					stack.push_back(std::make_pair(dependencyItr->second, (size_t)0));
+					descended = true;
+					break;
+				}
+
+				if (descended)
+					continue;
+
+				// All of the dependencies are complete
+				auto index = current.first;
+				long long longestDependencyChain(0);
+				size_t level(0);
+				for (auto dependencyOBI : dependencyNodes) {
+					auto dependencyItr = nodeIndices.find(dependencyOBI);
+					if (dependencyItr == nodeIndices.end())
+						continue;
+
+					auto dependencyIndex = dependencyItr->second;
+					if (criticalDependencies[index] == (size_t)-1 || finishTimes[dependencyIndex] > longestDependencyChain) {
+						longestDependencyChain = finishTimes[dependencyIndex];
+						criticalDependencies[index] = dependencyIndex;
+					}
+					level = std::max(level, levels[dependencyIndex] + 1);
+				}
+
+				finishTimes[index] = longestDependencyChain + costs[index];
+				levels[index] = level;
+				stack.pop_back();
+			}
+		}
+
+		size_t lastOnCriticalPath(0);
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			if (finishTimes[i] > finishTimes[lastOnCriticalPath])
+				lastOnCriticalPath = i;
+
+			if (levels[i] >= analysis.widthPerLevel.size())
+				analysis.widthPerLevel.resize(levels[i] + 1, 0);
+			analysis.widthPerLevel[levels[i]]++;
+		}
+
+		analysis.span = std::chrono::nanoseconds(finishTimes[lastOnCriticalPath]);
+
+		for (auto index = lastOnCriticalPath; index != (size_t)-1; index = criticalDependencies[index])
+			analysis.criticalPath.push_back(nodes[index]->key);
+		std::reverse(analysis.criticalPath.begin(), analysis.criticalPath.end());
+
+		return analysis;
+	}
+
+	// Analyses the object context using the measured build times, i.e. after it has been built
+	template <class TKeyType, class TValueType, class TBuilderPolicy>
+	ParallelismAnalysis<TKeyType> AnalyseParallelism(ObjectContext<TKeyType, TValueType, TBuilderPolicy>& objectContext) {
+		return AnalyseParallelism(objectContext, &MeasuredNodeCost<TKeyType, TValueType, TBuilderPolicy>);
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IDependencyGraphJobQueue.h"
+#include "ThreadPoolConfiguration.h"
 
 #include <mutex>
 #include <queue>
@@ -29,6 +30,12 @@ namespace dependencygraph {
 			this->_pJobQueue->push(job);
 			this->_pConditionVariable->notify_all();
 		}
+
+		size_t GetQueuedJobCount() override
+		{
+			std::unique_lock<std::mutex> lock(*_pQueueAccessMutex);
+			return this->_pJobQueue->size();
+		}
 	};
 
 	// Class to demonstrate the separation between a job queue as far as an object context is concerned
@@ -54,6 +61,7 @@ namespace dependencygraph {
 
 	public:
 		PriorityBasedMultithreadedJobQueue(int threadCount);
+		PriorityBasedMultithreadedJobQueue(const ThreadPoolConfiguration& configuration);
 
 		~PriorityBasedMultithreadedJobQueue();
 		void StopThreads();
@@ -63,71 +71,79 @@ namespace dependencygraph {
 	};
 
 	PriorityBasedMultithreadedJobQueue::PriorityBasedMultithreadedJobQueue(int threadCount) :
+		PriorityBasedMultithreadedJobQueue(ThreadPoolConfiguration::FromThreadCount(threadCount)) {
+	}
+
+	// Note that the worker groups are only used for thread placement, the two lanes are shared by all threads
+	PriorityBasedMultithreadedJobQueue::PriorityBasedMultithreadedJobQueue(const ThreadPoolConfiguration& configuration) :
 		_stopRequested(false),
 		totalRequests(0) {
-		if (threadCount == 0)
+		if (configuration.GetTotalThreadCount() <= 0)
 			throw std::exception("Invalid thread count specified");
 
-		if (threadCount < 0) {
-			// TODO - Read this value in from somewhere
-			threadCount = 16;
-		}
-
 		this->highPriorityJobQueue = std::make_shared<PriorityBasedMultithreadedJobQueueJobQueue>(&this->_jobsHP, &this->_queueAccessMutex, &this->_queueAccessCV);
-		this->lowPriorityJobQueue = std::make_shared<PriorityBasedMultithreadedJobQueueJobQueue>(&this->_jobsHP, &this->_queueAccessMutex, &this->_queueAccessCV);
-
-		for (int i(0); i < threadCount; ++i) {
-			_threads.push_back(std::thread([this]() -> void {
+		this->lowPriorityJobQueue = std::make_shared<PriorityBasedMultithreadedJobQueueJobQueue>(&this->_jobsLP, &this->_queueAccessMutex, &this->_queueAccessCV);
 
-				while (true) {
-					try {
-						if (_stopRequested)
-							return;
+		for (int workerGroupIdx(0); workerGroupIdx < (int)configuration.workerGroups.size(); ++workerGroupIdx) {
+			for (int i(0); i < configuration.workerGroups[workerGroupIdx].threadCount; ++i) {
+				_threads.push_back(std::thread([this, configuration, workerGroupIdx, i]() -> void {
 
-						std::unique_lock<std::mutex> lock(this->_queueAccessMutex);
+					ApplyWorkerPlacement(configuration, workerGroupIdx, i);
 
-						if (!this->_jobsHP.empty()) {
-							// We have a high priority job
-							auto job = std::move(this->_jobsHP.front());
-							this->_jobsHP.pop();
-							lock.unlock();
+					while (true) {
+						try {
+							if (_stopRequested)
+								return;
 
-							try
-							{
-								job.func();
+							std::unique_lock<std::mutex> lock(this->_queueAccessMutex);
+
+							if (!this->_jobsHP.empty()) {
+								// We have a high priority job
+								auto job = std::move(this->_jobsHP.front());
+								this->_jobsHP.pop();
+								lock.unlock();
+
+								SetCurrentJobQueue(this->highPriorityJobQueue.get());
+								try
+								{
+									job.func();
+								}
+								catch (...) {
+									// What to do here?
+								}
+								SetCurrentJobQueue(nullptr);
 							}
-							catch (...) {
-								// What to do here?
+							else if (!this->_jobsLP.empty()) {
+								// We have a low priority job
+								auto job = std::move(this->_jobsLP.front());
+								this->_jobsLP.pop();
+								lock.unlock();
+
+								SetCurrentJobQueue(this->lowPriorityJobQueue.get());
+								try
+								{
+									job.func();
+								}
+								catch (...) {
+									// What to do here?
+								}
+								SetCurrentJobQueue(nullptr);
 							}
-						}
-						else if (!this->_jobsLP.empty()) {
-							// We have a low priority job
-							auto job = std::move(this->_jobsLP.front());
-							this->_jobsLP.pop();
-							lock.unlock();
-
-							try
-							{
-								job.func();
-							}
-							catch (...) {
-								// What to do here?
+							else {
+								// Nothing to do
+								if (_stopRequested)
+									return;
+
+								this->_queueAccessCV.wait(lock);
 							}
 						}
-						else {
-							// Nothing to do
-							if (_stopRequested)
-								return;
+						catch (...) {
 
-							this->_queueAccessCV.wait(lock);
 						}
 					}
-					catch (...) {
-
-					}
-				}
 
-				}));
+					}));
+			}
 		}
 	}
 
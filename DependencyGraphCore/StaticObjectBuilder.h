@@ -0,0 +1,142 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "IObjectBuilder.h"
+#include "IObjectBuilderProvider.h"
+#include "ObjectBuilderPolicy.h"
+
+namespace dependencygraph {
+
+	// CRTP base for object builders which are known at compile time, e.g.
+	//
+	//	class SumObjectBuilder : public StaticObjectBuilder<SumObjectBuilder, int, double> {
+	//	public:
+	//		std::vector<int> DiscoverDependencies(const int& address);
+	//		double Build(const int& address, const DependencyValues<int, double>& dependencies);
+	//	};
+	//
+	// The overrides are final and call the derived class directly, so there's no std::function and the
+	// dependencies are always borrowed rather than copied into a map. Through a context with the default
+	// (dynamic) policy the builder is still called through IObjectBuilder, i.e. one virtual call per discovery
+	// and per build. A context with StaticObjectBuilderPolicy (see below) calls the derived class directly
+	// instead, so that its code is inlined into the node execution loop.
+	template <class TDerived, class TKeyType, class TValueType>
+	class StaticObjectBuilder : public IObjectBuilder<TKeyType, TValueType> {
+	public:
+		using IObjectBuilder<TKeyType, TValueType>::BuildObject;
+
+		std::vector<TKeyType> GetDependencies(const TKeyType& address) final {
+			return static_cast<TDerived*>(this)->DiscoverDependencies(address);
+		}
+
+		TValueType BuildObject(const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) final {
+			return static_cast<TDerived*>(this)->Build(address, dependencies);
+		}
+
+		bool IsConstant() final {
+			return false;
+		}
+	};
+
+	// Static equivalent of FunctionBasedObjectBuilder, where the functions are held by their own types (e.g.
+	// lambdas) rather than as std::functions so that they can be inlined. Use MakeStaticObjectBuilder to
+	// create these.
+	template <class TKeyType, class TValueType, class TGetDependenciesFunc, class TBuildObjectFunc>
+	class StaticFunctionObjectBuilder final : public StaticObjectBuilder<StaticFunctionObjectBuilder<TKeyType, TValueType, TGetDependenciesFunc, TBuildObjectFunc>, TKeyType, TValueType> {
+	private:
+		TGetDependenciesFunc _getDependenciesFunc;
+		TBuildObjectFunc _buildObjectFunc;
+
+	public:
+		StaticFunctionObjectBuilder(TGetDependenciesFunc getDependenciesFunc, TBuildObjectFunc buildObjectFunc) :
+			_getDependenciesFunc(std::move(getDependenciesFunc)),
+			_buildObjectFunc(std::move(buildObjectFunc)) {
+		}
+
+		std::vector<TKeyType> DiscoverDependencies(const TKeyType& address) {
+			return this->_getDependenciesFunc(address);
+		}
+
+		TValueType Build(const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) {
+			return this->_buildObjectFunc(address, dependencies);
+		}
+	};
+
+	// Creates a static function based object builder, the build function takes the address and a
+	// DependencyValues view of the dependencies
+	template <class TKeyType, class TValueType, class TGetDependenciesFunc, class TBuildObjectFunc>
+	std::shared_ptr<StaticFunctionObjectBuilder<TKeyType, TValueType, TGetDependenciesFunc, TBuildObjectFunc>> MakeStaticObjectBuilder(TGetDependenciesFunc getDependenciesFunc, TBuildObjectFunc buildObjectFunc) {
+		return std::make_shared<StaticFunctionObjectBuilder<TKeyType, TValueType, TGetDependenciesFunc, TBuildObjectFunc>>(std::move(getDependenciesFunc), std::move(buildObjectFunc));
+	}
+
+	// Provider for graphs where every address is built by the same, statically known, object builder. The
+	// builder is handed out as is, so there's no lookup per node
+	template <class TKeyType, class TValueType, class TObjectBuilder>
+	class StaticObjectBuilderProvider final : public IObjectBuilderProvider<TKeyType, TValueType> {
+	private:
+		std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> _objectBuilder;
+
+	public:
+		StaticObjectBuilderProvider(std::shared_ptr<TObjectBuilder> objectBuilder) :
+			_objectBuilder(std::move(objectBuilder)) {
+		}
+
+		bool TryGetObjectBuilder(const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) override {
+			objectBuilder = this->_objectBuilder;
+			return true;
+		}
+	};
+
+	template <class TKeyType, class TValueType, class TObjectBuilder>
+	std::shared_ptr<StaticObjectBuilderProvider<TKeyType, TValueType, TObjectBuilder>> MakeStaticObjectBuilderProvider(std::shared_ptr<TObjectBuilder> objectBuilder) {
+		return std::make_shared<StaticObjectBuilderProvider<TKeyType, TValueType, TObjectBuilder>>(std::move(objectBuilder));
+	}
+
+	// Object builder policy (see DynamicObjectBuilderPolicy) for contexts whose every node is built by the same
+	// static builder, e.g.
+	//
+	//	ObjectContext<int, double, StaticObjectBuilderPolicy<int, double, SumObjectBuilder>> objectContext(
+	//		MakeStaticObjectBuilderProvider<int, double>(std::make_shared<SumObjectBuilder>()), jobQueue);
+	//
+	// The context is constructed with a StaticObjectBuilderProvider, and so the provider and builder types are
+	// known exactly - discovery and building call them directly (the provider being final, and the builder's
+	// DiscoverDependencies / Build being called on the derived class) rather than through the interfaces, and
+	// the batch / async / constant checks are resolved at compile time. Builders restored from a persisted
+	// topology must be of the same type, any others are left to be discovered.
+	template <class TKeyType, class TValueType, class TObjectBuilder>
+	class StaticObjectBuilderPolicy {
+	public:
+		typedef StaticObjectBuilderProvider<TKeyType, TValueType, TObjectBuilder> Provider;
+
+		static bool TryGetObjectBuilder(IObjectBuilderProvider<TKeyType, TValueType>& objectBuilderProvider, const TKeyType& address, std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>& objectBuilder) {
+			return static_cast<Provider&>(objectBuilderProvider).TryGetObjectBuilder(address, objectBuilder);
+		}
+
+		static bool IsConstant(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return false;
+		}
+
+		static std::vector<TKeyType> GetDependencies(IObjectBuilder<TKeyType, TValueType>& objectBuilder, const TKeyType& address) {
+			return static_cast<TObjectBuilder&>(objectBuilder).DiscoverDependencies(address);
+		}
+
+		static TValueType BuildObject(IObjectBuilder<TKeyType, TValueType>& objectBuilder, const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) {
+			return static_cast<TObjectBuilder&>(objectBuilder).Build(address, dependencies);
+		}
+
+		static IBatchObjectBuilder<TKeyType, TValueType>* GetBatchObjectBuilder(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return nullptr;
+		}
+
+		static IAsyncObjectBuilder<TKeyType, TValueType>* GetAsyncObjectBuilder(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return nullptr;
+		}
+
+		static bool IsSupported(IObjectBuilder<TKeyType, TValueType>& objectBuilder) {
+			return dynamic_cast<TObjectBuilder*>(&objectBuilder) != nullptr;
+		}
+	};
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+// Keep windows.h from defining min / max (which break std::min / std::max in anything included afterwards)
+// and from pulling in more of the API than the processor topology calls need
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dependencygraph {
+
+	// A set of worker threads which should be kept together, typically those running on a single NUMA node
+	struct ThreadPoolWorkerGroup {
+		int threadCount;
+
+		// The logical processors which the group's threads may run on. If empty, the threads are left to
+		// float freely as per the operating system's scheduler
+		std::vector<int> processors;
+
+		ThreadPoolWorkerGroup() : threadCount(0) { }
+		ThreadPoolWorkerGroup(int threadCount, std::vector<int> processors) : threadCount(threadCount), processors(std::move(processors)) { }
+	};
+
+	// Describes how the threads of a thread pool based job queue should be created and placed.
+	//
+	// Where more than one worker group is supplied, job queues which support it will prefer to run a job
+	// on the worker group which built most of the job's dependencies so that values are consumed on the
+	// same NUMA node as the one they were built on.
+	class ThreadPoolConfiguration {
+	public:
+		std::vector<ThreadPoolWorkerGroup> workerGroups;
+
+		// If set, each thread is pinned to a single processor from its group (round-robin) rather than
+		// being allowed to run on any of the group's processors
+		bool pinThreadsToProcessors;
+
+		ThreadPoolConfiguration() : pinThreadsToProcessors(false) { }
+
+		int GetTotalThreadCount() const {
+			int total(0);
+			for (auto& workerGroup : this->workerGroups)
+				total += workerGroup.threadCount;
+			return total;
+		}
+
+		// A single group of freely floating threads. A negative thread count means that the count
+		// should be taken from the hardware / process limits
+		static ThreadPoolConfiguration FromThreadCount(int threadCount);
+
+		// One worker group per NUMA node, with the threads spread round-robin across the nodes.  If the NUMA
+		// topology cannot be determined, then this is equivalent to FromThreadCount
+		static ThreadPoolConfiguration PerNumaNode(int threadCount = -1);
+
+		// The number of threads which the process can actually make use of, taking into account the
+		// hardware, the process affinity mask and (on Linux) any cgroup CPU quota
+		static int GetDefaultThreadCount();
+
+		// The logical processors belonging to each NUMA node, empty if unknown
+		static std::vector<std::vector<int>> GetNumaNodeProcessors();
+	};
+
+	// Returns the worker group of the calling thread, or -1 if it isn't a job queue worker thread
+	inline int& currentWorkerGroupStorage() {
+		static thread_local int workerGroup = -1;
+		return workerGroup;
+	}
+
+	inline int GetCurrentWorkerGroup() {
+		return currentWorkerGroupStorage();
+	}
+
+	inline void SetCurrentWorkerGroup(int workerGroup) {
+		currentWorkerGroupStorage() = workerGroup;
+	}
+
+	// Restricts the calling thread to the supplied logical processors, returns false if not supported / failed
+	inline bool SetCurrentThreadAffinity(const std::vector<int>& processors) {
+		if (processors.empty())
+			return false;
+
+#if defined(_WIN32)
+		// Note that this only handles the first processor group (i.e. the first 64 logical processors)
+		DWORD_PTR mask(0);
+		for (auto processor : processors) {
+			if (processor >= 0 && processor < (int)(sizeof(DWORD_PTR) * 8))
+				mask |= ((DWORD_PTR)1) << processor;
+		}
+
+		if (mask == 0)
+			return false;
+
+		return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		for (auto processor : processors) {
+			if (processor >= 0 && processor < CPU_SETSIZE)
+				CPU_SET(processor, &cpuSet);
+		}
+
+		return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+		return false;
+#endif
+	}
+
+	// Applies the placement for the index'th thread of the supplied worker group to the calling thread
+	inline void ApplyWorkerPlacement(const ThreadPoolConfiguration& configuration, int workerGroupIdx, int threadIdx) {
+		SetCurrentWorkerGroup(workerGroupIdx);
+
+		auto& processors = configuration.workerGroups[workerGroupIdx].processors;
+		if (processors.empty())
+			return;
+
+		if (configuration.pinThreadsToProcessors)
+			SetCurrentThreadAffinity({ processors[threadIdx % processors.size()] });
+		else
+			SetCurrentThreadAffinity(processors);
+	}
+
+#if defined(__linux__)
+	// Parses a Linux cpu list, e.g. "0-7,16-23"
+	inline std::vector<int> parseLinuxCpuList(const std::string& cpuList) {
+		std::vector<int> processors;
+		std::stringstream stream(cpuList);
+		std::string range;
+		while (std::getline(stream, range, ',')) {
+			if (range.empty())
+				continue;
+
+			auto dashPos = range.find('-');
+			try {
+				if (dashPos == std::string::npos) {
+					processors.push_back(std::stoi(range));
+				}
+				else {
+					int first = std::stoi(range.substr(0, dashPos));
+					int last = std::stoi(range.substr(dashPos + 1));
+					for (int processor = first; processor <= last; ++processor)
+						processors.push_back(processor);
+				}
+			}
+			catch (...) {
+			}
+		}
+		return processors;
+	}
+
+	// Returns the CPU limit imposed by the cgroup (v2 or v1) CPU quota, or -1 if there isn't one
+	inline int readLinuxCgroupCpuLimit() {
+		{
+			std::ifstream cpuMax("/sys/fs/cgroup/cpu.max");
+			std::string quota;
+			long long period(0);
+			if (cpuMax >> quota >> period) {
+				if (quota != "max" && period > 0) {
+					auto quotaValue = std::stoll(quota);
+					return (int)std::max(1LL, (quotaValue + period - 1) / period);
+				}
+				return -1;
+			}
+		}
+
+		{
+			std::ifstream cfsQuota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+			std::ifstream cfsPeriod("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+			long long quota(0), period(0);
+			if ((cfsQuota >> quota) && (cfsPeriod >> period) && quota > 0 && period > 0)
+				return (int)std::max(1LL, (quota + period - 1) / period);
+		}
+
+		return -1;
+	}
+#endif
+
+	inline int ThreadPoolConfiguration::GetDefaultThreadCount() {
+		int threadCount = (int)std::thread::hardware_concurrency();
+
+#if defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0) {
+			int affinityCount = CPU_COUNT(&cpuSet);
+			if (affinityCount > 0 && (threadCount <= 0 || affinityCount < threadCount))
+				threadCount = affinityCount;
+		}
+
+		int cgroupLimit = readLinuxCgroupCpuLimit();
+		if (cgroupLimit > 0 && (threadCount <= 0 || cgroupLimit < threadCount))
+			threadCount = cgroupLimit;
+#endif
+
+		if (threadCount <= 0)
+			threadCount = 1;
+
+		return threadCount;
+	}
+
+	inline std::vector<std::vector<int>> ThreadPoolConfiguration::GetNumaNodeProcessors() {
+		std::vector<std::vector<int>> numaNodes;
+
+#if defined(_WIN32)
+		ULONG highestNodeNumber(0);
+		if (!GetNumaHighestNodeNumber(&highestNodeNumber))
+			return numaNodes;
+
+		for (USHORT node = 0; node <= highestNodeNumber; ++node) {
+			GROUP_AFFINITY groupAffinity;
+			if (!GetNumaNodeProcessorMaskEx(node, &groupAffinity) || groupAffinity.Mask == 0)
+				continue;
+
+			// Only the first processor group is supported, see SetCurrentThreadAffinity
+			if (groupAffinity.Group != 0)
+				continue;
+
+			std::vector<int> processors;
+			for (int bit = 0; bit < (int)(sizeof(KAFFINITY) * 8); ++bit) {
+				if (groupAffinity.Mask & (((KAFFINITY)1) << bit))
+					processors.push_back(bit);
+			}
+			numaNodes.push_back(std::move(processors));
+		}
+#elif defined(__linux__)
+		for (int node = 0; ; ++node) {
+			std::ifstream cpuListFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			if (!cpuListFile)
+				break;
+
+			std::string cpuList;
+			std::getline(cpuListFile, cpuList);
+			auto processors = parseLinuxCpuList(cpuList);
+			if (!processors.empty())
+				numaNodes.push_back(std::move(processors));
+		}
+#endif
+
+		return numaNodes;
+	}
+
+	inline ThreadPoolConfiguration ThreadPoolConfiguration::FromThreadCount(int threadCount) {
+		if (threadCount == 0)
+			throw std::exception("Invalid thread count specified");
+
+		if (threadCount < 0)
+			threadCount = GetDefaultThreadCount();
+
+		ThreadPoolConfiguration configuration;
+		configuration.workerGroups.push_back(ThreadPoolWorkerGroup(threadCount, std::vector<int>()));
+		return configuration;
+	}
+
+	inline ThreadPoolConfiguration ThreadPoolConfiguration::PerNumaNode(int threadCount) {
+		auto numaNodes = GetNumaNodeProcessors();
+		if (numaNodes.size() <= 1)
+			return FromThreadCount(threadCount);
+
+		if (threadCount == 0)
+			throw std::exception("Invalid thread count specified");
+
+		if (threadCount < 0)
+			threadCount = GetDefaultThreadCount();
+
+		ThreadPoolConfiguration configuration;
+		for (auto& processors : numaNodes)
+			configuration.workerGroups.push_back(ThreadPoolWorkerGroup(0, processors));
+
+		for (int i = 0; i < threadCount; ++i)
+			configuration.workerGroups[i % configuration.workerGroups.size()].threadCount++;
+
+		// Drop any empty groups (fewer threads than nodes)
+		configuration.workerGroups.erase(
+			std::remove_if(configuration.workerGroups.begin(), configuration.workerGroups.end(), [](const ThreadPoolWorkerGroup& workerGroup) { return workerGroup.threadCount == 0; }),
+			configuration.workerGroups.end());
+
+		return configuration;
+	}
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "IDependencyGraphJobQueue.h"
+#include "ObjectBuildingState.h"
+#include "ValueStorage.h"
+#include "WaitHandle.h"
+
+namespace dependencygraph {
+
+	// Declares the kinds of node which a node kind depends upon, e.g.
+	//
+	//	struct OptionPrice {
+	//		using KeyType = OptionId;
+	//		using ValueType = double;
+	//		using Dependencies = TypedDependencies<Spot, VolSurface>;
+	//
+	//		std::tuple<std::string, std::string> GetDependencies(const OptionId& key);
+	//		double Build(const OptionId& key, const double& spot, const Surface& vol);
+	//	};
+	//
+	// GetDependencies returns the keys of the dependencies (one per dependency kind, in the same order) and
+	// Build receives their values with their exact types. Both may be static.
+	template <class... TNodeKinds>
+	struct TypedDependencies {
+		using KeyTuple = std::tuple<typename TNodeKinds::KeyType...>;
+	};
+
+	template <class T, class... Ts>
+	struct containsType : std::false_type {};
+
+	template <class T, class U, class... Ts>
+	struct containsType<T, U, Ts...> : std::integral_constant<bool, std::is_same<T, U>::value || containsType<T, Ts...>::value> {};
+
+	// Forward definitions
+	template <class TContext, class TNodeKind> class TypedNode;
+	template <class... TNodeKinds> class TypedObjectContext;
+
+	template <class TContext, class TDependencies>
+	struct typedDependencyNodes;
+
+	// Nodes whose dependencies are yet to be discovered, these are worked through with an explicit stack rather
+	// than by recursing into each dependency as it's requested
+	using typedDiscoveryStack = std::vector<std::function<void()>>;
+
+	template <class TContext, class... TDependencyKinds>
+	struct typedDependencyNodes<TContext, TypedDependencies<TDependencyKinds...>> {
+		using type = std::tuple<TypedNode<TContext, TDependencyKinds>*...>;
+	};
+
+	// A node within a TypedObjectContext, the typed equivalent of ObjectBuilderInfo
+	template <class TContext, class TNodeKind>
+	class TypedNode {
+	public:
+		using KeyType = typename TNodeKind::KeyType;
+		using ValueType = typename TNodeKind::ValueType;
+
+	private:
+		template <class... T> friend class TypedObjectContext;
+		template <class TOtherContext, class TOtherNodeKind> friend class TypedNode;
+
+		using dependencyNodes = typename typedDependencyNodes<TContext, typename TNodeKind::Dependencies>::type;
+		static constexpr size_t dependencyCount = std::tuple_size<dependencyNodes>::value;
+
+		TContext* _context;
+		std::atomic<ObjectBuildingState> _state;
+		std::atomic<bool> _buildRequested;
+		std::atomic<int> _outstandingDependenciesCount;
+		dependencyNodes _dependencyNodes;
+		ValueStorage<ValueType> _builtObject;
+		std::vector<std::function<void()>> _postBuildCallBacks;
+
+		void requestBuild();
+		void requestBuild(typedDiscoveryStack& discoveryStack);
+		void dependencyCompleted();
+		void buildObject();
+		void setObjectBuilt(ValueType&& builtObject);
+		void setObjectFailed(std::shared_ptr<std::exception> exception, std::exception_ptr exceptionPtr = nullptr);
+		void setCompleted(ObjectBuildingState state);
+
+		template <class TDependencyKeys, size_t... I>
+		void resolveDependencies(const TDependencyKeys& dependencyKeys, std::index_sequence<I...>) {
+			this->_dependencyNodes = dependencyNodes(this->_context->template getOrCreateNode<typename std::remove_pointer<typename std::tuple_element<I, dependencyNodes>::type>::type::nodeKind>(std::get<I>(dependencyKeys))...);
+		}
+
+		template <size_t... I>
+		void requestDependencies(typedDiscoveryStack& discoveryStack, std::index_sequence<I...>) {
+			int expansion[] = { 0, (this->requestDependency(discoveryStack, std::get<I>(this->_dependencyNodes)), 0)... };
+			(void)expansion;
+		}
+
+		template <class TDependencyNode>
+		void requestDependency(typedDiscoveryStack& discoveryStack, TDependencyNode* dependencyNode) {
+			if (!dependencyNode->_buildRequested.load())
+				discoveryStack.push_back([dependencyNode, &discoveryStack]() { dependencyNode->requestBuild(discoveryStack); });
+
+			dependencyNode->RegisterPostBuildCallBack([this]() { this->dependencyCompleted(); });
+		}
+
+		template <size_t... I>
+		bool allDependenciesBuilt(std::index_sequence<I...>) const {
+			bool results[] = { true, (std::get<I>(this->_dependencyNodes)->getState() == ObjectBuildingState::ObjectBuilt)... };
+			for (auto result : results) {
+				if (!result)
+					return false;
+			}
+			return true;
+		}
+
+		template <size_t... I>
+		ValueType build(std::index_sequence<I...>) {
+			return this->_context->template GetNodeKind<TNodeKind>().Build(this->key, std::get<I>(this->_dependencyNodes)->_builtObject.Get()...);
+		}
+
+	public:
+		using nodeKind = TNodeKind;
+
+		const KeyType key;
+
+		dependencygraph::WaitHandle objectBuiltOrFailureWaitHandle;
+		std::mutex objectBuiltOrFailureMutex;
+		std::condition_variable objectBuiltOrFailureCV;
+
+		std::shared_ptr<std::exception> exception;
+
+		// The exception which caused the failure, if the node failed due to an exception
+		std::exception_ptr exceptionPtr;
+
+		TypedNode(TContext* context, const KeyType& key) :
+			_context(context),
+			_state(ObjectBuildingState::Starting),
+			_buildRequested(false),
+			_outstandingDependenciesCount(0),
+			key(key),
+			objectBuiltOrFailureWaitHandle(&_state, &objectBuiltOrFailureMutex, &objectBuiltOrFailureCV, { ObjectBuildingState::Failure, ObjectBuildingState::ObjectBuilt }) {
+		}
+
+		ObjectBuildingState getState() const {
+			return this->_state.load();
+		}
+
+		const ValueType& GetBuiltObject() const {
+			if (!this->_builtObject.HasValue())
+				throw std::exception("Object has not been built");
+
+			return this->_builtObject.Get();
+		}
+
+		// Runs the call back once the node has been built or has failed (straight away if it already has)
+		void RegisterPostBuildCallBack(std::function<void()>&& callBackFunc);
+	};
+
+	// Object context for graphs whose node kinds, and the types of their values and dependencies, are known at
+	// compile time, e.g. TypedObjectContext<Spot, VolSurface, OptionPrice>.
+	//
+	// Each node kind has its own key and value type, and builders receive their dependencies' values with
+	// their exact types - there's no variant / base class boxing of the values, nor any virtual calls to
+	// discover or build a node. The nodes are built through the usual job queues and expose the usual wait
+	// handle.
+	//
+	// The node kind instances are held by the context (default constructed, see GetNodeKind) and so can carry
+	// whatever configuration their builders need.
+	template <class... TNodeKinds>
+	class TypedObjectContext {
+	public:
+		template <class TNodeKind>
+		using Node = TypedNode<TypedObjectContext<TNodeKinds...>, TNodeKind>;
+
+		TypedObjectContext(std::shared_ptr<IDependencyGraphJobQueue> jobQueue) :
+			_jobQueue(jobQueue) {
+		}
+
+		template <class TNodeKind>
+		std::shared_ptr<Node<TNodeKind>> BuildObject(const typename TNodeKind::KeyType& key) {
+			static_assert(containsType<TNodeKind, TNodeKinds...>::value, "The node kind isn't part of this context");
+
+			auto node = this->getOrCreateNodePtr<TNodeKind>(key);
+			node->requestBuild();
+			return node;
+		}
+
+		template <class TNodeKind>
+		TNodeKind& GetNodeKind() {
+			return std::get<TNodeKind>(this->_nodeKinds);
+		}
+
+	private:
+		template <class TContext, class TNodeKind> friend class TypedNode;
+
+		template <class TNodeKind>
+		struct nodeStore {
+			std::mutex accessMutex;
+			std::unordered_map<typename TNodeKind::KeyType, std::shared_ptr<Node<TNodeKind>>> nodes;
+		};
+
+		template <class TNodeKind>
+		std::shared_ptr<Node<TNodeKind>> getOrCreateNodePtr(const typename TNodeKind::KeyType& key) {
+			auto& store = std::get<nodeStore<TNodeKind>>(this->_nodeStores);
+			std::unique_lock<std::mutex> lock(store.accessMutex);
+			auto& node = store.nodes[key];
+			if (!node)
+				node = std::make_shared<Node<TNodeKind>>(this, key);
+
+			return node;
+		}
+
+		template <class TNodeKind>
+		Node<TNodeKind>* getOrCreateNode(const typename TNodeKind::KeyType& key) {
+			static_assert(containsType<TNodeKind, TNodeKinds...>::value, "A dependency kind isn't part of this context");
+
+			return this->getOrCreateNodePtr<TNodeKind>(key).get();
+		}
+
+		std::shared_ptr<IDependencyGraphJobQueue> _jobQueue;
+		std::tuple<TNodeKinds...> _nodeKinds;
+		std::tuple<nodeStore<TNodeKinds>...> _nodeStores;
+	};
+
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::requestBuild() {
+		typedDiscoveryStack discoveryStack;
+		this->requestBuild(discoveryStack);
+
+		while (!discoveryStack.empty()) {
+			auto requestFunc = std::move(discoveryStack.back());
+			discoveryStack.pop_back();
+			requestFunc();
+		}
+	}
+
+	// Discovers the node's dependencies, with any which haven't been requested yet being pushed onto the stack
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::requestBuild(typedDiscoveryStack& discoveryStack) {
+		if (this->_buildRequested.exchange(true))
+			return;
+
+		try
+		{
+			auto dependencyKeys = this->_context->template GetNodeKind<TNodeKind>().GetDependencies(this->key);
+			this->resolveDependencies(dependencyKeys, std::make_index_sequence<dependencyCount>());
+		}
+		catch (...)
+		{
+			auto exception = std::make_shared<std::exception>("Discovery failed");
+			this->setObjectFailed(exception, std::current_exception());
+			return;
+		}
+
+		this->_state = ObjectBuildingState::DependenciesKnown;
+
+		// The extra count stops the build from being scheduled until all of the dependencies have been requested
+		this->_outstandingDependenciesCount.store((int)dependencyCount + 1);
+		this->requestDependencies(discoveryStack, std::make_index_sequence<dependencyCount>());
+		this->dependencyCompleted();
+	}
+
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::dependencyCompleted() {
+		if (this->_outstandingDependenciesCount.fetch_sub(1) != 1)
+			return;
+
+		this->_context->_jobQueue->RegisterJob(DependencyGraphJob(DependencyGraphJobStyle::objectBuilding, [this]() { this->buildObject(); }));
+	}
+
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::buildObject() {
+		if (!this->allDependenciesBuilt(std::make_index_sequence<dependencyCount>())) {
+			auto exception = std::make_shared<std::exception>("Failed to source dependency");
+			this->setObjectFailed(exception);
+			return;
+		}
+
+		try
+		{
+			this->setObjectBuilt(this->build(std::make_index_sequence<dependencyCount>()));
+		}
+		catch (...)
+		{
+			auto exception = std::make_shared<std::exception>("Failed to build object dependency");
+			this->setObjectFailed(exception, std::current_exception());
+		}
+	}
+
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::setObjectBuilt(ValueType&& builtObject) {
+		this->_builtObject.Set(std::move(builtObject));
+		this->setCompleted(ObjectBuildingState::ObjectBuilt);
+	}
+
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::setObjectFailed(std::shared_ptr<std::exception> exception, std::exception_ptr exceptionPtr) {
+		this->exception = exception;
+		this->exceptionPtr = exceptionPtr;
+		this->setCompleted(ObjectBuildingState::Failure);
+	}
+
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::setCompleted(ObjectBuildingState state) {
+		std::vector<std::function<void()>> postBuildCallBacks;
+		{
+			std::unique_lock<std::mutex> lock(this->objectBuiltOrFailureMutex);
+			this->_state = state;
+			this->objectBuiltOrFailureCV.notify_all();
+			postBuildCallBacks.swap(this->_postBuildCallBacks);
+		}
+
+		for (auto& callBack : postBuildCallBacks) {
+			try {
+				callBack();
+			}
+			catch (...) {
+
+			}
+		}
+	}
+
+	template <class TContext, class TNodeKind>
+	void TypedNode<TContext, TNodeKind>::RegisterPostBuildCallBack(std::function<void()>&& callBackFunc) {
+		{
+			std::unique_lock<std::mutex> lock(this->objectBuiltOrFailureMutex);
+			switch (this->getState()) {
+			case ObjectBuildingState::ObjectBuilt:
+			case ObjectBuildingState::Failure:
+				break;
+
+			default:
+				this->_postBuildCallBacks.push_back(std::move(callBackFunc));
+				return;
+			}
+		}
+
+		// Can run immediately...
+		if (callBackFunc)
+			callBackFunc();
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dependencygraph {
+
+	// In-place storage for a value which may or may not have been set yet.
+	//
+	// This allows nodes to hold their built value without requiring the value type to be default
+	// constructible or copyable, and without a separate heap allocation per node.
+	template <class T>
+	class ValueStorage {
+	private:
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+		bool _hasValue;
+
+	public:
+		ValueStorage() : _hasValue(false) { }
+		~ValueStorage() { this->Reset(); }
+
+		ValueStorage(const ValueStorage&) = delete;
+		ValueStorage& operator=(const ValueStorage&) = delete;
+
+		bool HasValue() const {
+			return this->_hasValue;
+		}
+
+		void Set(T&& value) {
+			this->Reset();
+			new (&this->_storage) T(std::move(value));
+			this->_hasValue = true;
+		}
+
+		void Set(const T& value) {
+			this->Reset();
+			new (&this->_storage) T(value);
+			this->_hasValue = true;
+		}
+
+		const T& Get() const {
+			return *reinterpret_cast<const T*>(&this->_storage);
+		}
+
+		T& Get() {
+			return *reinterpret_cast<T*>(&this->_storage);
+		}
+
+		void Reset() {
+			if (!this->_hasValue)
+				return;
+
+			this->Get().~T();
+			this->_hasValue = false;
+		}
+	};
+}
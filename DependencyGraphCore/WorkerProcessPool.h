@@ -0,0 +1,585 @@
+#pragma once
+
+#if defined(_WIN32)
+#error "WorkerProcessPool is currently only supported on POSIX platforms"
+#endif
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "IObjectBuilder.h"
+
+namespace dependencygraph {
+
+	// User supplied serialization for keys and values which need to cross the process boundary.
+	//
+	// The serialize functions write directly into the supplied buffer (typically the shared memory segment
+	// for the worker) and return the number of bytes required. If this is larger than the capacity then
+	// nothing should have been written and the function will be called again with a big enough buffer.
+	template <class TKeyType, class TValueType>
+	struct WorkerProcessSerialization {
+		std::function<size_t(const TKeyType&, char* buffer, size_t capacity)> serializeKey;
+		std::function<TKeyType(const char* buffer, size_t size)> deserializeKey;
+		std::function<size_t(const TValueType&, char* buffer, size_t capacity)> serializeValue;
+		std::function<TValueType(const char* buffer, size_t size)> deserializeValue;
+
+		// Serialization for key and value types which can simply be copied byte for byte
+		static WorkerProcessSerialization<TKeyType, TValueType> TriviallyCopyable() {
+			static_assert(std::is_trivially_copyable<TKeyType>::value && std::is_trivially_copyable<TValueType>::value, "Key and value types must be trivially copyable");
+
+			WorkerProcessSerialization<TKeyType, TValueType> serialization;
+			serialization.serializeKey = &serializeTrivial<TKeyType>;
+			serialization.deserializeKey = &deserializeTrivial<TKeyType>;
+			serialization.serializeValue = &serializeTrivial<TValueType>;
+			serialization.deserializeValue = &deserializeTrivial<TValueType>;
+			return serialization;
+		}
+
+	private:
+		template <class T>
+		static size_t serializeTrivial(const T& value, char* buffer, size_t capacity) {
+			if (capacity >= sizeof(T))
+				std::memcpy(buffer, &value, sizeof(T));
+			return sizeof(T);
+		}
+
+		template <class T>
+		static T deserializeTrivial(const char* buffer, size_t size) {
+			if (size != sizeof(T))
+				throw std::runtime_error("Unexpected payload size");
+
+			T value;
+			std::memcpy(&value, buffer, sizeof(T));
+			return value;
+		}
+	};
+
+	// Pool of forked worker processes which build objects on behalf of the current process.
+	//
+	// Each worker has its own shared memory segment which requests (key and dependency values) and responses
+	// (the built value or an error) are serialized straight into, with a Unix socket pair used only to signal
+	// that a message is ready. Payloads which are too large for the segment are streamed over the socket instead.
+	//
+	// Builders are registered before the workers are started so that the forked workers inherit them. Note
+	// that Start() must be called before any other threads (e.g. job queue threads) are created as forking a
+	// multi-threaded process is unsafe. A worker which dies (e.g. due to a crash in a builder) fails the
+	// objects which it was building and is not replaced; the remaining workers carry on.
+	//
+	// The job queue for the object context should be given (at least) as many threads as there are workers,
+	// as each job queue thread waits on a worker whilst the object is built remotely.
+	template <class TKeyType, class TValueType>
+	class WorkerProcessPool {
+	private:
+		struct MessageHeader {
+			uint64_t size;
+			uint32_t streamedPayload;
+			uint32_t status;
+		};
+
+		struct WorkerChannel {
+			pid_t pid;
+			int socket;
+			char* sharedBuffer;
+			bool alive;
+		};
+
+		// Writes into the shared buffer, switching over to a heap buffer if the message doesn't fit
+		class payloadWriter {
+		private:
+			char* _sharedBuffer;
+			size_t _sharedBufferSize;
+			std::string _overflowBuffer;
+			bool _overflowed;
+			size_t _size;
+
+			char* buffer() {
+				return this->_overflowed ? &this->_overflowBuffer[0] : this->_sharedBuffer;
+			}
+
+			size_t capacity() const {
+				return this->_overflowed ? this->_overflowBuffer.size() : this->_sharedBufferSize;
+			}
+
+			void ensureCapacity(size_t required) {
+				if (this->_size + required <= this->capacity())
+					return;
+
+				if (!this->_overflowed) {
+					this->_overflowBuffer.assign(this->_sharedBuffer, this->_size);
+					this->_overflowed = true;
+				}
+				this->_overflowBuffer.resize((this->_size + required) * 2);
+			}
+
+		public:
+			payloadWriter(char* sharedBuffer, size_t sharedBufferSize) :
+				_sharedBuffer(sharedBuffer),
+				_sharedBufferSize(sharedBufferSize),
+				_overflowed(false),
+				_size(0) {
+			}
+
+			void Write(const void* data, size_t size) {
+				this->ensureCapacity(size);
+				std::memcpy(this->buffer() + this->_size, data, size);
+				this->_size += size;
+			}
+
+			void WriteUInt32(uint32_t value) {
+				this->Write(&value, sizeof(value));
+			}
+
+			// Writes a length prefixed item through the supplied serializer
+			template <class T>
+			void WriteItem(const T& item, const std::function<size_t(const T&, char*, size_t)>& serialize) {
+				this->ensureCapacity(sizeof(uint32_t));
+				auto lengthOffset = this->_size;
+				this->_size += sizeof(uint32_t);
+
+				auto available = this->capacity() - this->_size;
+				auto required = serialize(item, this->buffer() + this->_size, available);
+				if (required > available) {
+					this->ensureCapacity(required);
+					serialize(item, this->buffer() + this->_size, required);
+				}
+
+				auto length = (uint32_t)required;
+				std::memcpy(this->buffer() + lengthOffset, &length, sizeof(length));
+				this->_size += required;
+			}
+
+			bool IsInSharedMemory() const { return !this->_overflowed; }
+			size_t Size() const { return this->_size; }
+			const char* Data() { return this->buffer(); }
+		};
+
+		class payloadReader {
+		private:
+			const char* _buffer;
+			size_t _size;
+			size_t _position;
+
+		public:
+			payloadReader(const char* buffer, size_t size) : _buffer(buffer), _size(size), _position(0) { }
+
+			uint32_t ReadUInt32() {
+				uint32_t value;
+				if (this->_position + sizeof(value) > this->_size)
+					throw std::runtime_error("Truncated worker message");
+
+				std::memcpy(&value, this->_buffer + this->_position, sizeof(value));
+				this->_position += sizeof(value);
+				return value;
+			}
+
+			template <class T>
+			T ReadItem(const std::function<T(const char*, size_t)>& deserialize) {
+				auto length = this->ReadUInt32();
+				if (this->_position + length > this->_size)
+					throw std::runtime_error("Truncated worker message");
+
+				auto item = deserialize(this->_buffer + this->_position, length);
+				this->_position += length;
+				return item;
+			}
+		};
+
+		WorkerProcessSerialization<TKeyType, TValueType> _serialization;
+		size_t _sharedBufferSize;
+		std::vector<std::shared_ptr<IObjectBuilder<TKeyType, TValueType>>> _objectBuilders;
+
+		std::vector<WorkerChannel> _workers;
+		std::vector<int> _idleWorkers;
+		int _aliveWorkerCount;
+
+		// Workers which have been handed out to a build, Stop() waits for these to be returned as the build
+		// is still using the worker's channel
+		int _busyWorkerCount;
+		bool _stopping;
+		std::mutex _workersAccessMutex;
+		std::condition_variable _workersAccessCV;
+
+		static bool writeFully(int socket, const char* data, size_t size);
+		static bool readFully(int socket, char* data, size_t size);
+		static bool sendMessage(int socket, char* sharedBuffer, payloadWriter& writer, uint32_t status);
+		static bool receiveMessage(int socket, const char* sharedBuffer, std::string& overflowBuffer, MessageHeader& header, const char*& payload);
+
+		void runWorker(int socket, char* sharedBuffer);
+		int acquireWorker();
+		void releaseWorker(int workerIdx, bool alive);
+
+	public:
+		WorkerProcessPool(WorkerProcessSerialization<TKeyType, TValueType> serialization, size_t sharedBufferSize = 1024 * 1024);
+		~WorkerProcessPool();
+
+		// Registers a builder which the workers will be able to run, must be called before Start()
+		int RegisterBuilder(std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder);
+
+		std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> GetLocalBuilder(int builderId) {
+			return this->_objectBuilders[builderId];
+		}
+
+		void Start(int workerCount);
+
+		// Stops the workers, waiting for any builds which are using a worker to finish first. Builds which
+		// haven't got a worker yet fail
+		void Stop();
+
+		// Builds the object in one of the worker processes, blocking until the result is available
+		TValueType BuildObject(int builderId, const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies);
+	};
+
+	// Object builder which discovers dependencies locally but builds the object in a worker process
+	template <class TKeyType, class TValueType>
+	class WorkerProcessObjectBuilder : public IObjectBuilder<TKeyType, TValueType> {
+	private:
+		std::shared_ptr<WorkerProcessPool<TKeyType, TValueType>> _workerProcessPool;
+		int _builderId;
+
+	public:
+		WorkerProcessObjectBuilder(std::shared_ptr<WorkerProcessPool<TKeyType, TValueType>> workerProcessPool, int builderId) :
+			_workerProcessPool(workerProcessPool),
+			_builderId(builderId) {
+		}
+
+		std::vector<TKeyType> GetDependencies(const TKeyType& address) override {
+			return this->_workerProcessPool->GetLocalBuilder(this->_builderId)->GetDependencies(address);
+		}
+
+		TValueType BuildObject(const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) override {
+			return this->_workerProcessPool->BuildObject(this->_builderId, address, dependencies);
+		}
+	};
+
+	template <class TKeyType, class TValueType>
+	WorkerProcessPool<TKeyType, TValueType>::WorkerProcessPool(WorkerProcessSerialization<TKeyType, TValueType> serialization, size_t sharedBufferSize) :
+		_serialization(serialization),
+		_sharedBufferSize(sharedBufferSize),
+		_aliveWorkerCount(0),
+		_busyWorkerCount(0),
+		_stopping(false) {
+	}
+
+	template <class TKeyType, class TValueType>
+	WorkerProcessPool<TKeyType, TValueType>::~WorkerProcessPool() {
+		this->Stop();
+	}
+
+	template <class TKeyType, class TValueType>
+	int WorkerProcessPool<TKeyType, TValueType>::RegisterBuilder(std::shared_ptr<IObjectBuilder<TKeyType, TValueType>> objectBuilder) {
+		if (!this->_workers.empty())
+			throw std::runtime_error("Builders must be registered before the workers are started");
+
+		this->_objectBuilders.push_back(objectBuilder);
+		return (int)this->_objectBuilders.size() - 1;
+	}
+
+	template <class TKeyType, class TValueType>
+	void WorkerProcessPool<TKeyType, TValueType>::Start(int workerCount) {
+		if (workerCount <= 0)
+			throw std::runtime_error("Invalid worker count specified");
+
+		{
+			std::unique_lock<std::mutex> lock(this->_workersAccessMutex);
+			this->_stopping = false;
+		}
+
+		for (int i = 0; i < workerCount; ++i) {
+			int sockets[2];
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+				throw std::runtime_error("Unable to create worker socket pair");
+
+			auto sharedBuffer = (char*)mmap(nullptr, this->_sharedBufferSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+			if (sharedBuffer == MAP_FAILED) {
+				close(sockets[0]);
+				close(sockets[1]);
+				throw std::runtime_error("Unable to create worker shared memory");
+			}
+
+			auto pid = fork();
+			if (pid < 0) {
+				munmap(sharedBuffer, this->_sharedBufferSize);
+				close(sockets[0]);
+				close(sockets[1]);
+				throw std::runtime_error("Unable to fork worker process");
+			}
+
+			if (pid == 0) {
+				// Worker process - we don't want to inherit the other workers' channels
+				close(sockets[0]);
+				for (auto& worker : this->_workers)
+					close(worker.socket);
+
+				this->runWorker(sockets[1], sharedBuffer);
+				_exit(0);
+			}
+
+			close(sockets[1]);
+
+			WorkerChannel worker;
+			worker.pid = pid;
+			worker.socket = sockets[0];
+			worker.sharedBuffer = sharedBuffer;
+			worker.alive = true;
+
+			std::unique_lock<std::mutex> lock(this->_workersAccessMutex);
+			this->_workers.push_back(worker);
+			this->_idleWorkers.push_back((int)this->_workers.size() - 1);
+			this->_aliveWorkerCount++;
+		}
+	}
+
+	template <class TKeyType, class TValueType>
+	void WorkerProcessPool<TKeyType, TValueType>::Stop() {
+		std::unique_lock<std::mutex> lock(this->_workersAccessMutex);
+
+		// Builds which hold a worker are writing to / reading from its channel and shared buffer, so they
+		// have to be finished with before those are torn down. No more workers are handed out meanwhile
+		this->_stopping = true;
+		this->_workersAccessCV.notify_all();
+		while (this->_busyWorkerCount > 0)
+			this->_workersAccessCV.wait(lock);
+
+		for (auto& worker : this->_workers) {
+			// Closing the socket causes the worker to exit once it's finished its current request
+			if (worker.socket >= 0)
+				close(worker.socket);
+			worker.socket = -1;
+		}
+
+		for (auto& worker : this->_workers) {
+			int status;
+			waitpid(worker.pid, &status, 0);
+			munmap(worker.sharedBuffer, this->_sharedBufferSize);
+		}
+
+		this->_workers.clear();
+		this->_idleWorkers.clear();
+		this->_aliveWorkerCount = 0;
+		this->_workersAccessCV.notify_all();
+	}
+
+	template <class TKeyType, class TValueType>
+	TValueType WorkerProcessPool<TKeyType, TValueType>::BuildObject(int builderId, const TKeyType& address, const DependencyValues<TKeyType, TValueType>& dependencies) {
+		auto workerIdx = this->acquireWorker();
+		auto& worker = this->_workers[workerIdx];
+
+		payloadWriter writer(worker.sharedBuffer, this->_sharedBufferSize);
+		writer.WriteUInt32((uint32_t)builderId);
+		writer.WriteItem(address, this->_serialization.serializeKey);
+		writer.WriteUInt32((uint32_t)dependencies.size());
+		for (size_t i = 0; i < dependencies.size(); ++i) {
+			writer.WriteItem(dependencies.GetKey(i), this->_serialization.serializeKey);
+			writer.WriteItem(dependencies.GetValue(i), this->_serialization.serializeValue);
+		}
+
+		MessageHeader header;
+		const char* payload(nullptr);
+		std::string overflowBuffer;
+		if (!sendMessage(worker.socket, worker.sharedBuffer, writer, 0) ||
+			!receiveMessage(worker.socket, worker.sharedBuffer, overflowBuffer, header, payload)) {
+			this->releaseWorker(workerIdx, false);
+			throw std::runtime_error("Worker process failed");
+		}
+
+		try {
+			if (header.status != 0) {
+				std::string message(payload, (size_t)header.size);
+				throw std::runtime_error(message);
+			}
+
+			payloadReader reader(payload, (size_t)header.size);
+			auto value = reader.ReadItem(this->_serialization.deserializeValue);
+			this->releaseWorker(workerIdx, true);
+			return value;
+		}
+		catch (...) {
+			this->releaseWorker(workerIdx, true);
+			throw;
+		}
+	}
+
+	template <class TKeyType, class TValueType>
+	int WorkerProcessPool<TKeyType, TValueType>::acquireWorker() {
+		std::unique_lock<std::mutex> lock(this->_workersAccessMutex);
+		while (this->_idleWorkers.empty() || this->_stopping) {
+			if (this->_stopping)
+				throw std::runtime_error("Worker process pool has been stopped");
+
+			if (this->_aliveWorkerCount == 0)
+				throw std::runtime_error("No worker processes available");
+
+			this->_workersAccessCV.wait(lock);
+		}
+
+		auto workerIdx = this->_idleWorkers.back();
+		this->_idleWorkers.pop_back();
+		this->_busyWorkerCount++;
+		return workerIdx;
+	}
+
+	template <class TKeyType, class TValueType>
+	void WorkerProcessPool<TKeyType, TValueType>::releaseWorker(int workerIdx, bool alive) {
+		std::unique_lock<std::mutex> lock(this->_workersAccessMutex);
+		auto& worker = this->_workers[workerIdx];
+		this->_busyWorkerCount--;
+		if (alive) {
+			this->_idleWorkers.push_back(workerIdx);
+		}
+		else if (worker.alive) {
+			// Leave the channel in place (it's reaped in Stop) but never hand it out again
+			worker.alive = false;
+			this->_aliveWorkerCount--;
+			kill(worker.pid, SIGKILL);
+		}
+
+		this->_workersAccessCV.notify_all();
+	}
+
+	template <class TKeyType, class TValueType>
+	void WorkerProcessPool<TKeyType, TValueType>::runWorker(int socket, char* sharedBuffer) {
+		std::string overflowBuffer;
+		while (true) {
+			MessageHeader header;
+			const char* payload(nullptr);
+			if (!receiveMessage(socket, sharedBuffer, overflowBuffer, header, payload))
+				return;
+
+			payloadWriter writer(sharedBuffer, this->_sharedBufferSize);
+			uint32_t status(0);
+			try {
+				payloadReader reader(payload, (size_t)header.size);
+				auto builderId = reader.ReadUInt32();
+				if (builderId >= this->_objectBuilders.size())
+					throw std::runtime_error("Unknown builder");
+
+				auto address = reader.ReadItem(this->_serialization.deserializeKey);
+				auto dependencyCount = reader.ReadUInt32();
+
+				std::vector<TKeyType> dependencyKeys;
+				std::vector<TValueType> dependencyValues;
+				dependencyKeys.reserve(dependencyCount);
+				dependencyValues.reserve(dependencyCount);
+				for (uint32_t i = 0; i < dependencyCount; ++i) {
+					dependencyKeys.push_back(reader.ReadItem(this->_serialization.deserializeKey));
+					dependencyValues.push_back(reader.ReadItem(this->_serialization.deserializeValue));
+				}
+
+				std::vector<const TValueType*> dependencyValuePtrs;
+				dependencyValuePtrs.reserve(dependencyCount);
+				for (auto& dependencyValue : dependencyValues)
+					dependencyValuePtrs.push_back(&dependencyValue);
+
+				DependencyValues<TKeyType, TValueType> dependencies(dependencyKeys.data(), dependencyValuePtrs.data(), dependencyKeys.size());
+				auto value = this->_objectBuilders[builderId]->BuildObject(address, dependencies);
+				writer.WriteItem(value, this->_serialization.serializeValue);
+			}
+			catch (const std::exception& e) {
+				payloadWriter errorWriter(sharedBuffer, this->_sharedBufferSize);
+				errorWriter.Write(e.what(), std::strlen(e.what()));
+				writer = std::move(errorWriter);
+				status = 1;
+			}
+			catch (...) {
+				payloadWriter errorWriter(sharedBuffer, this->_sharedBufferSize);
+				errorWriter.Write("Unknown failure", 15);
+				writer = std::move(errorWriter);
+				status = 1;
+			}
+
+			if (!sendMessage(socket, sharedBuffer, writer, status))
+				return;
+		}
+	}
+
+	template <class TKeyType, class TValueType>
+	bool WorkerProcessPool<TKeyType, TValueType>::writeFully(int socket, const char* data, size_t size) {
+		while (size > 0) {
+#if defined(MSG_NOSIGNAL)
+			auto written = send(socket, data, size, MSG_NOSIGNAL);
+#else
+			auto written = send(socket, data, size, 0);
+#endif
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+
+			data += written;
+			size -= (size_t)written;
+		}
+		return true;
+	}
+
+	template <class TKeyType, class TValueType>
+	bool WorkerProcessPool<TKeyType, TValueType>::readFully(int socket, char* data, size_t size) {
+		while (size > 0) {
+			auto bytesRead = recv(socket, data, size, 0);
+			if (bytesRead < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+
+			if (bytesRead == 0)
+				return false;
+
+			data += bytesRead;
+			size -= (size_t)bytesRead;
+		}
+		return true;
+	}
+
+	template <class TKeyType, class TValueType>
+	bool WorkerProcessPool<TKeyType, TValueType>::sendMessage(int socket, char* sharedBuffer, payloadWriter& writer, uint32_t status) {
+		MessageHeader header;
+		header.size = writer.Size();
+		header.streamedPayload = writer.IsInSharedMemory() ? 0 : 1;
+		header.status = status;
+
+		if (!writeFully(socket, (const char*)&header, sizeof(header)))
+			return false;
+
+		// Payloads which fit are already sitting in shared memory, so only the header is sent
+		if (header.streamedPayload)
+			return writeFully(socket, writer.Data(), writer.Size());
+
+		return true;
+	}
+
+	template <class TKeyType, class TValueType>
+	bool WorkerProcessPool<TKeyType, TValueType>::receiveMessage(int socket, const char* sharedBuffer, std::string& overflowBuffer, MessageHeader& header, const char*& payload) {
+		if (!readFully(socket, (char*)&header, sizeof(header)))
+			return false;
+
+		if (!header.streamedPayload) {
+			payload = sharedBuffer;
+			return true;
+		}
+
+		overflowBuffer.resize((size_t)header.size);
+		if (header.size > 0 && !readFully(socket, &overflowBuffer[0], (size_t)header.size))
+			return false;
+
+		payload = overflowBuffer.data();
+		return true;
+	}
+}